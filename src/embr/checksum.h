@@ -0,0 +1,489 @@
+/**
+ *  @file
+ *  Internet checksum (RFC 1071) and CRC32 digests, plus helpers to run them
+ *  directly over netbuf chains
+ *
+ *  Digests all share the signature:
+ *      void update(const void* data, size_t n) = feed in more bytes
+ *      value() = digest of everything fed in so far
+ *      void reset() = start over
+ *
+ *  so they may be fed one netbuf chunk at a time, including chunks of odd length
+ */
+#pragma once
+
+#include "netbuf-gather.h"
+#include "internal/endian.h"
+
+// true (the default) uses whatever vector extensions compiler has enabled,
+// false forces scalar kernels
+#ifndef ENABLE_EMBR_CHECKSUM_SIMD
+#define ENABLE_EMBR_CHECKSUM_SIMD true
+#endif
+
+// slice-by-8 CRC32 is roughly 4x faster than slice-by-1, but its tables take 8k rather
+// than 1k of RAM.  So by default it's only used on 64-bit targets
+#ifndef ENABLE_EMBR_CRC32_SLICE_BY_8
+#if UINTPTR_MAX > 0xFFFFFFFF
+#define ENABLE_EMBR_CRC32_SLICE_BY_8 true
+#else
+#define ENABLE_EMBR_CRC32_SLICE_BY_8 false
+#endif
+#endif
+
+#if ENABLE_EMBR_CHECKSUM_SIMD
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define FEATURE_EMBR_CHECKSUM_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define FEATURE_EMBR_CHECKSUM_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define FEATURE_EMBR_CHECKSUM_NEON
+#endif
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#define FEATURE_EMBR_CRC32C_SSE42
+#endif
+
+#if defined(__ARM_FEATURE_CRC32) && !defined(FEATURE_EMBR_BIG_ENDIAN)
+#include <arm_acle.h>
+#define FEATURE_EMBR_CRC32_ARM
+#endif
+#endif
+
+namespace embr {
+
+namespace internal {
+
+// add with end-around carry, keeping a 64-bit accumulator congruent to the
+// 16-bit one's complement sum
+inline uint64_t ones_add(uint64_t sum, uint64_t v)
+{
+    sum += v;
+    return sum + (sum < v);
+}
+
+inline uint16_t ones_fold(uint64_t sum)
+{
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFFFFFF) + (sum >> 32);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    sum = (sum & 0xFFFF) + (sum >> 16);
+    return (uint16_t)sum;
+}
+
+// Sums p as native-endian 16-bit words, a trailing odd byte being padded with zero
+// as per RFC 1071.  Result is unfolded.  32-bit loads are fine since
+// 2^16 == 1 (mod 0xFFFF), and a 64-bit accumulator can't overflow on any realistic n
+inline uint64_t ones_sum_native_scalar(const uint8_t* p, size_t n)
+{
+    uint64_t sum = 0;
+
+    while(n >= 8)
+    {
+        sum += load_native<uint32_t>(p);
+        sum += load_native<uint32_t>(p + 4);
+        p += 8;
+        n -= 8;
+    }
+
+    if(n >= 4)
+    {
+        sum += load_native<uint32_t>(p);
+        p += 4;
+        n -= 4;
+    }
+
+    if(n >= 2)
+    {
+        sum += load_native<uint16_t>(p);
+        p += 2;
+        n -= 2;
+    }
+
+    if(n)
+    {
+        uint8_t padded[2] = { *p, 0 };
+        sum += load_native<uint16_t>(padded);
+    }
+
+    return sum;
+}
+
+// vector flavors widen 16-bit words into 32-bit lanes.  Each lane gains at most
+// 2 * 0xFFFF per block, so 16384 blocks is safely short of lane overflow
+#define EMBR_CHECKSUM_MAX_BLOCKS 16384
+
+#if defined(FEATURE_EMBR_CHECKSUM_AVX2)
+inline uint64_t ones_sum_native(const uint8_t* p, size_t n)
+{
+    const __m256i zero = _mm256_setzero_si256();
+    uint64_t sum = 0;
+
+    while(n >= 32)
+    {
+        size_t blocks = n / 32;
+
+        if(blocks > EMBR_CHECKSUM_MAX_BLOCKS) blocks = EMBR_CHECKSUM_MAX_BLOCKS;
+
+        n -= blocks * 32;
+
+        __m256i acc = zero;
+
+        while(blocks--)
+        {
+            __m256i v = _mm256_loadu_si256((const __m256i*)p);
+            acc = _mm256_add_epi32(acc, _mm256_unpacklo_epi16(v, zero));
+            acc = _mm256_add_epi32(acc, _mm256_unpackhi_epi16(v, zero));
+            p += 32;
+        }
+
+        uint32_t lanes[8];
+        _mm256_storeu_si256((__m256i*)lanes, acc);
+
+        for(int i = 0; i < 8; i++) sum += lanes[i];
+    }
+
+    return sum + ones_sum_native_scalar(p, n);
+}
+#elif defined(FEATURE_EMBR_CHECKSUM_SSE2)
+inline uint64_t ones_sum_native(const uint8_t* p, size_t n)
+{
+    const __m128i zero = _mm_setzero_si128();
+    uint64_t sum = 0;
+
+    while(n >= 16)
+    {
+        size_t blocks = n / 16;
+
+        if(blocks > EMBR_CHECKSUM_MAX_BLOCKS) blocks = EMBR_CHECKSUM_MAX_BLOCKS;
+
+        n -= blocks * 16;
+
+        __m128i acc = zero;
+
+        while(blocks--)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i*)p);
+            acc = _mm_add_epi32(acc, _mm_unpacklo_epi16(v, zero));
+            acc = _mm_add_epi32(acc, _mm_unpackhi_epi16(v, zero));
+            p += 16;
+        }
+
+        uint32_t lanes[4];
+        _mm_storeu_si128((__m128i*)lanes, acc);
+
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    return sum + ones_sum_native_scalar(p, n);
+}
+#elif defined(FEATURE_EMBR_CHECKSUM_NEON)
+inline uint64_t ones_sum_native(const uint8_t* p, size_t n)
+{
+    uint64_t sum = 0;
+
+    while(n >= 16)
+    {
+        size_t blocks = n / 16;
+
+        if(blocks > EMBR_CHECKSUM_MAX_BLOCKS) blocks = EMBR_CHECKSUM_MAX_BLOCKS;
+
+        n -= blocks * 16;
+
+        uint32x4_t acc = vdupq_n_u32(0);
+
+        while(blocks--)
+        {
+            // byte load so that p needn't be 16-bit aligned
+            acc = vpadalq_u16(acc, vreinterpretq_u16_u8(vld1q_u8(p)));
+            p += 16;
+        }
+
+        uint32_t lanes[4];
+        vst1q_u32(lanes, acc);
+
+        sum += (uint64_t)lanes[0] + lanes[1] + lanes[2] + lanes[3];
+    }
+
+    return sum + ones_sum_native_scalar(p, n);
+}
+#else
+inline uint64_t ones_sum_native(const uint8_t* p, size_t n)
+{
+    return ones_sum_native_scalar(p, n);
+}
+#endif
+
+#undef EMBR_CHECKSUM_MAX_BLOCKS
+
+
+// 256 entry lookup tables for reflected CRC32 polynomial 'poly'.  Built upon first use.
+// Table 'k' holds the CRC of each byte followed by k zero bytes, which is what lets
+// slice-by-8 fold in 8 bytes per step.  Only the first is used for slice-by-1
+template <uint32_t poly, unsigned slices>
+struct Crc32Table
+{
+    uint32_t entries[slices][256];
+
+    Crc32Table()
+    {
+        for(uint32_t i = 0; i < 256; i++)
+        {
+            uint32_t c = i;
+
+            for(int bit = 0; bit < 8; bit++)
+                c = (c & 1) ? (c >> 1) ^ poly : c >> 1;
+
+            entries[0][i] = c;
+        }
+
+        for(unsigned k = 1; k < slices; k++)
+            for(uint32_t i = 0; i < 256; i++)
+            {
+                uint32_t c = entries[k - 1][i];
+                entries[k][i] = (c >> 8) ^ entries[0][c & 0xFF];
+            }
+    }
+
+    static const Crc32Table& instance()
+    {
+        static Crc32Table table;
+        return table;
+    }
+};
+
+template <uint32_t poly>
+struct Crc32Kernel
+{
+#if ENABLE_EMBR_CRC32_SLICE_BY_8
+    typedef Crc32Table<poly, 8> table_type;
+#else
+    typedef Crc32Table<poly, 1> table_type;
+#endif
+
+    static uint32_t update(uint32_t crc, const uint8_t* p, size_t n)
+    {
+        const table_type& table = table_type::instance();
+
+#if ENABLE_EMBR_CRC32_SLICE_BY_8
+        const uint32_t (*t)[256] = table.entries;
+
+        for(; n >= 8; n -= 8, p += 8)
+        {
+            uint32_t lo = load_native<uint32_t>(p);
+            uint32_t hi = load_native<uint32_t>(p + 4);
+
+            if(!is_little_endian())
+            {
+                lo = byteswap(lo);
+                hi = byteswap(hi);
+            }
+
+            lo ^= crc;
+
+            crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^
+                  t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+                  t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^
+                  t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+        }
+#endif
+
+        const uint32_t* t0 = table.entries[0];
+
+        while(n--)
+            crc = t0[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+
+        return crc;
+    }
+};
+
+// x86 only has a Castagnoli CRC instruction
+#if defined(FEATURE_EMBR_CRC32C_SSE42)
+template <>
+struct Crc32Kernel<0x82F63B78>
+{
+    static uint32_t update(uint32_t crc, const uint8_t* p, size_t n)
+    {
+#if defined(__x86_64__)
+        uint64_t crc64 = crc;
+
+        for(; n >= 8; n -= 8, p += 8)
+            crc64 = _mm_crc32_u64(crc64, load_native<uint64_t>(p));
+
+        crc = (uint32_t)crc64;
+#endif
+        for(; n >= 4; n -= 4, p += 4)
+            crc = _mm_crc32_u32(crc, load_native<uint32_t>(p));
+
+        while(n--)
+            crc = _mm_crc32_u8(crc, *p++);
+
+        return crc;
+    }
+};
+#endif
+
+// ARMv8 CRC extension does both
+#if defined(FEATURE_EMBR_CRC32_ARM)
+template <>
+struct Crc32Kernel<0xEDB88320>
+{
+    static uint32_t update(uint32_t crc, const uint8_t* p, size_t n)
+    {
+        for(; n >= 4; n -= 4, p += 4)
+            crc = __crc32w(crc, load_native<uint32_t>(p));
+
+        while(n--)
+            crc = __crc32b(crc, *p++);
+
+        return crc;
+    }
+};
+
+template <>
+struct Crc32Kernel<0x82F63B78>
+{
+    static uint32_t update(uint32_t crc, const uint8_t* p, size_t n)
+    {
+        for(; n >= 4; n -= 4, p += 4)
+            crc = __crc32cw(crc, load_native<uint32_t>(p));
+
+        while(n--)
+            crc = __crc32cb(crc, *p++);
+
+        return crc;
+    }
+};
+#endif
+
+template <class TDigest>
+struct DigestChunkVisitor
+{
+    TDigest& digest;
+
+    DigestChunkVisitor(TDigest& digest) : digest(digest) {}
+
+    template <class TSize>
+    bool operator()(const void* data, TSize size)
+    {
+        digest.update(data, size);
+        return true;
+    }
+};
+
+}
+
+namespace experimental {
+
+// RFC 1071 one's complement sum.  Tracks whether an odd number of bytes has been
+// fed so far, so that chunk boundaries can fall anywhere
+class InternetChecksum
+{
+    uint64_t m_sum;
+    bool m_odd;
+
+public:
+    InternetChecksum() : m_sum(0), m_odd(false) {}
+
+    void reset()
+    {
+        m_sum = 0;
+        m_odd = false;
+    }
+
+    void update(const void* data, size_t n)
+    {
+        if(n == 0) return;
+
+        uint16_t partial = internal::ones_fold(
+            internal::ones_sum_native(static_cast<const uint8_t*>(data), n));
+
+        // byte swapping commutes with one's complement addition, so convert the
+        // native sum to network order just once
+        if(internal::is_little_endian()) partial = internal::byteswap(partial);
+
+        // data began at an odd offset, so every byte sits in the opposite half
+        // of its word from what we assumed
+        if(m_odd) partial = internal::byteswap(partial);
+
+        m_sum = internal::ones_add(m_sum, partial);
+        m_odd ^= (n & 1) != 0;
+    }
+
+    // folded, uncomplemented sum
+    uint16_t sum() const { return internal::ones_fold(m_sum); }
+
+    // checksum as it goes into a header field, in host order
+    uint16_t value() const { return (uint16_t)~sum(); }
+};
+
+// reflected, table driven CRC32.  Uses hardware CRC instructions where available,
+// otherwise slice-by-8 or slice-by-1 tables (see ENABLE_EMBR_CRC32_SLICE_BY_8)
+template <uint32_t poly>
+class Crc32
+{
+    uint32_t m_crc;
+
+public:
+    Crc32() : m_crc(0xFFFFFFFF) {}
+
+    void reset() { m_crc = 0xFFFFFFFF; }
+
+    void update(const void* data, size_t n)
+    {
+        m_crc = internal::Crc32Kernel<poly>::update(m_crc, static_cast<const uint8_t*>(data), n);
+    }
+
+    uint32_t value() const { return ~m_crc; }
+};
+
+// zlib/ethernet flavor
+typedef Crc32<0xEDB88320> Crc32Ieee;
+// Castagnoli flavor (iSCSI, SCTP)
+typedef Crc32<0x82F63B78> Crc32c;
+
+
+///
+/// \brief feeds each chunk of netbuf's entire chain into digest
+///
+/// netbuf is left positioned on the chunk it started on
+///
+template <class TDigest, class TNetBuf>
+TDigest& digest(TDigest& d, TNetBuf& netbuf)
+{
+    internal::DigestChunkVisitor<TDigest> visitor(d);
+
+    mem::internal::for_each_chunk(netbuf, visitor);
+
+    return d;
+}
+
+template <class TNetBuf>
+uint16_t internet_checksum(TNetBuf& netbuf)
+{
+    InternetChecksum d;
+    return digest(d, netbuf).value();
+}
+
+template <class TNetBuf>
+uint32_t crc32(TNetBuf& netbuf)
+{
+    Crc32Ieee d;
+    return digest(d, netbuf).value();
+}
+
+template <class TNetBuf>
+uint32_t crc32c(TNetBuf& netbuf)
+{
+    Crc32c d;
+    return digest(d, netbuf).value();
+}
+
+}
+
+}
@@ -11,7 +11,8 @@ template <class TDatapump>
 struct DataPortEvents :
     // Be careful, TDatapumpWithRetry is being used as transport description.  In this case, it's OK
     event::Transport<TDatapump>,
-    event::Datapump<typename TDatapump::Item> {};
+    event::Datapump<typename TDatapump::Item>,
+    event::DatapumpQueue<typename TDatapump::counters_type> {};
 
 // NOTE: For now, this actually is just a test event to make sure our event system
 // is working as expected
@@ -101,6 +102,18 @@ struct DatapumpSubject
     // with transport itself
     void service();
 
+    ///
+    /// \brief like service(), but works through up to max_items queued from transport
+    ///
+    /// Items are claimed from datapump batch_size at a time, so thread safe queue
+    /// policies synchronize once per batch rather than once per item.  In aggregate mode
+    /// one receive_batch_dequeued fires per batch instead of receive_dequeuing/receive_dequeued
+    /// per item
+    /// \return number of items processed
+    ///
+    template <size_t batch_size = 16>
+    size_t service_batch(size_t max_items, bool aggregate = false);
+
     // FIX: Still need a graceful solution for wrapped/unwrapped
     template <class TEvent>
     void notify(const TEvent& e, bool wrapped = true)
@@ -122,9 +135,14 @@ struct DatapumpSubject
 
 
     // application send out -> datapump -> (eventual transport send)
-    void enqueue_for_send(netbuf_type&& nb, const addr_t& addr);
+    // \return outcome, any overflow also being announced via a queue_xxx event
+    QueueStatus enqueue_for_send(netbuf_type&& nb, const addr_t& addr);
     // transport receive in -> datapump -> (eventual application process)
-    void enqueue_from_receive(netbuf_type&& nb, const addr_t& addr);
+    // \return outcome, any overflow also being announced via a queue_xxx event
+    QueueStatus enqueue_from_receive(netbuf_type&& nb, const addr_t& addr);
+
+private:
+    void notify_overflow(QueueStatus status, bool incoming);
 };
 
 // DataPump and Transport combined, plus a subject to send out
@@ -179,6 +197,16 @@ public:
     // also evalutes from-transport queue, though presently counts on external party
     // to populate that
     void service();
+
+    ///
+    /// \brief like service(), but for up to max_items in each direction
+    ///
+    /// See DatapumpSubject::service_batch.  In aggregate mode one send_batch_sent fires per
+    /// batch of outgoing items instead of transport_sending/transport_sent/send_dequeued per item
+    /// \return number of items processed, both directions combined
+    ///
+    template <size_t batch_size = 16>
+    size_t service_batch(size_t max_items, bool aggregate = false);
 };
 
 
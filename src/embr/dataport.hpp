@@ -6,9 +6,13 @@ template <class TDatapump, class TTransportDescriptor, class TSubject>
 void DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::service()
 {
     // anything queued from transport in? (for application processing)
-    if(!datapump.dequeue_empty())
+    // claim rather than front/pop so that thread safe queue policies may have
+    // multiple callers servicing at once
+    item_t* claimed = datapump.dequeue_claim();
+
+    if(claimed != NULLPTR)
     {
-        item_t& item = datapump.dequeue_front();
+        item_t& item = *claimed;
 
         notify(typename event::receive_dequeuing(item));
 
@@ -21,8 +25,48 @@ void DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::service()
 
         notify(typename event::receive_dequeued(item));
 
-        datapump.dequeue_pop();
+        datapump.dequeue_release(claimed);
+    }
+}
+
+template <class TDatapump, class TTransportDescriptor, class TSubject>
+template <size_t batch_size>
+size_t DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::service_batch(
+    size_t max_items, bool aggregate)
+{
+    item_t* items[batch_size];
+    size_t total = 0;
+
+    while(total < max_items)
+    {
+        size_t remaining = max_items - total;
+        size_t n = datapump.dequeue_bulk(items, remaining < batch_size ? remaining : batch_size);
+
+        if(n == 0) break;
+
+        if(aggregate)
+            notify(typename event::receive_batch_dequeued(items, n));
+
+        for(size_t i = 0; i < n; i++)
+        {
+            item_t& item = *items[i];
+
+            if(!aggregate) notify(typename event::receive_dequeuing(item));
+
+#ifndef FEATURE_EMBR_DATAPUMP_INLINE
+            // FIX: Need a much more cohesive way of doing this
+            delete item.netbuf();
+#endif
+
+            if(!aggregate) notify(typename event::receive_dequeued(item));
+        }
+
+        datapump.dequeue_release_bulk(items, n);
+
+        total += n;
     }
+
+    return total;
 }
 
 // NOTE: All this demands inline-mode, but technically doesn't have to with a bit
@@ -55,11 +99,14 @@ void DataPort<TDatapump, TTransport, TSubject, wrapped>::service()
 */
 
     // anything queued for transport out?
-    if(!base_t::datapump.transport_empty())
+    item_t* claimed = base_t::datapump.transport_claim();
+
+    if(claimed != NULLPTR)
     {
-        item_t& item = base_t::datapump.transport_front();
+        item_t& item = *claimed;
         netbuf_type& netbuf = *item.netbuf();
-        const addr_t& addr = item.addr();
+        // copy, since once released another thread may reuse item's slot
+        const addr_t addr = item.addr();
 
         notify(typename event::transport_sending(netbuf, addr));
 
@@ -67,43 +114,141 @@ void DataPort<TDatapump, TTransport, TSubject, wrapped>::service()
 
         notify(typename event::transport_sent(netbuf, addr));
 
-        base_t::datapump.transport_pop();
+        base_t::datapump.transport_release(claimed);
 
         notify(typename event::send_dequeued(0, addr));
     }
 }
 
+template <class TDatapump, class TTransport, class TSubject, bool wrapped>
+template <size_t batch_size>
+size_t DataPort<TDatapump, TTransport, TSubject, wrapped>::service_batch(
+    size_t max_items, bool aggregate)
+{
+    size_t total = base_t::template service_batch<batch_size>(max_items, aggregate);
+
+    item_t* items[batch_size];
+    // copies, since once released another thread may reuse items' slots
+    addr_t addrs[batch_size];
+    size_t sent = 0;
+
+    while(sent < max_items)
+    {
+        size_t remaining = max_items - sent;
+        size_t n = base_t::datapump.transport_claim_bulk(items,
+            remaining < batch_size ? remaining : batch_size);
+
+        if(n == 0) break;
+
+        for(size_t i = 0; i < n; i++)
+        {
+            netbuf_type& netbuf = *items[i]->netbuf();
+            const addr_t& addr = items[i]->addr();
+
+            if(!aggregate) notify(typename event::transport_sending(netbuf, addr));
+
+            transport.send(netbuf, addr);
+
+            if(!aggregate)
+            {
+                notify(typename event::transport_sent(netbuf, addr));
+                addrs[i] = addr;
+            }
+        }
+
+        if(aggregate)
+            notify(typename event::send_batch_sent(items, n));
+
+        base_t::datapump.transport_release_bulk(items, n);
+
+        // as with service(), fires just after release
+        if(!aggregate)
+            for(size_t i = 0; i < n; i++)
+                notify(typename event::send_dequeued(0, addrs[i]));
+
+        sent += n;
+    }
+
+    return total + sent;
+}
+
+template <class TDatapump, class TTransportDescriptor, class TSubject>
+void DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::notify_overflow(
+    QueueStatus status, bool incoming)
+{
+    const typename datapump_t::counters_type& counters = incoming ?
+        datapump.incoming_counters() :
+        datapump.outgoing_counters();
+
+    switch(status)
+    {
+        case QueueOKDroppedOldest:
+            notify(typename event::queue_dropped_oldest(incoming, counters));
+            break;
+
+        case QueueDroppedNewest:
+            notify(typename event::queue_dropped_newest(incoming, counters));
+            break;
+
+        case QueueRejected:
+            notify(typename event::queue_rejected(incoming, counters));
+            break;
+
+        case QueueTimedOut:
+            notify(typename event::queue_timed_out(incoming, counters));
+            break;
+
+        default:
+            break;
+    }
+}
+
+
 template <class TDatapump, class TTransportDescriptor, class TSubject>
-void DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::enqueue_for_send(
+QueueStatus DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::enqueue_for_send(
     netbuf_type&& nb,
     const addr_t& addr)
 {
+    QueueStatus status;
+
 #ifdef FEATURE_EMBR_DATAPUMP_INLINE
-    const item_t& item = datapump.enqueue_out(std::move(nb), addr);
+    const item_t* item = datapump.enqueue_out(std::move(nb), addr, &status);
 #else
-    const item_t& item = datapump.enqueue_out(nb, addr);
+    const item_t* item = datapump.enqueue_out(nb, addr, &status);
     // FIX: probably needs additional housekeeping for non-inline flavor
 #endif
 
-    notify(typename event::send_queued(item));
+    notify_overflow(status, false);
+
+    if(item != NULLPTR)
+        notify(typename event::send_queued(*item));
+
+    return status;
 }
 
 
 template <class TDatapump, class TTransportDescriptor, class TSubject>
-void DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::enqueue_from_receive(
+QueueStatus DatapumpSubject<TDatapump, TTransportDescriptor, TSubject>::enqueue_from_receive(
     netbuf_type&& nb,
     const addr_t& addr)
 {
+    QueueStatus status;
+
     // think of datapump as a application-level queue, while
     // udp_data_recv sorta responds to a system-level queue
 #ifdef FEATURE_EMBR_DATAPUMP_INLINE
-    const item_t& item = datapump.transport_in(std::move(nb), addr);
+    const item_t* item = datapump.transport_in(std::move(nb), addr, &status);
 #else
-    const item_t& item = datapump.transport_in(nb, addr);
+    const item_t* item = datapump.transport_in(nb, addr, &status);
     // FIX: probably needs additional housekeeping for non-inline flavor
 #endif
 
-    notify(typename event::receive_queued(item));
+    notify_overflow(status, true);
+
+    if(item != NULLPTR)
+        notify(typename event::receive_queued(*item));
+
+    return status;
 }
 
 }
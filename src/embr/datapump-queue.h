@@ -0,0 +1,767 @@
+/**
+ * @file
+ * Thread safe queue policies for DataPump, so that transport (i.e. lwIP tcpip thread)
+ * and application (DataPort::service) sides may run on different cores without a mutex,
+ * and in the MPMC case so that several workers may service() at once
+ *
+ * Requires C++11 <atomic>
+ */
+#pragma once
+
+#include "datapump.h"
+
+#include <atomic>
+#include <chrono>
+#include <stdint.h>
+#include <new>
+#include <thread>
+#include <type_traits>
+
+// padding applied between indices touched by different threads, so that producer
+// and consumer don't fight over the same cache line
+#ifndef EMBR_CACHE_LINE_SIZE
+#define EMBR_CACHE_LINE_SIZE 64
+#endif
+
+namespace embr {
+
+namespace experimental {
+
+///
+/// \brief bounded wait-free single-producer/single-consumer ring
+///
+/// Producer side: full(), emplace(), push(), back()
+/// Consumer side: empty(), front(), pop()
+///
+/// Each side keeps a private cached copy of the other's index and only goes back
+/// to the shared atomic when that copy says full/empty, so in steady state neither
+/// side reads the other's cache line
+///
+template <class T, size_t N>
+class SpscRing
+{
+public:
+    typedef T value_type;
+    typedef T& reference;
+    typedef const T& const_reference;
+    typedef size_t size_type;
+
+private:
+    // one slot always left open to tell full from empty
+    static const size_type slots = N + 1;
+
+    struct alignas(EMBR_CACHE_LINE_SIZE) Index
+    {
+        std::atomic<size_type> value;
+        // this side's last known value of the opposing index
+        mutable size_type cached;
+
+        Index() : value(0), cached(0) {}
+    };
+
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_type;
+
+    // written by consumer
+    Index m_head;
+    // written by producer
+    Index m_tail;
+
+    alignas(EMBR_CACHE_LINE_SIZE) storage_type m_storage[slots];
+
+    static size_type increment(size_type i) { return i + 1 == slots ? 0 : i + 1; }
+
+    static size_type used_between(size_type head, size_type tail)
+    {
+        return tail >= head ? tail - head : slots - head + tail;
+    }
+
+    static size_type free_between(size_type head, size_type tail)
+    {
+        return N - used_between(head, tail);
+    }
+
+    T* slot(size_type i) { return reinterpret_cast<T*>(&m_storage[i]); }
+    const T* slot(size_type i) const { return reinterpret_cast<const T*>(&m_storage[i]); }
+
+    // producer side
+    T* acquire_tail()
+    {
+        size_type t = m_tail.value.load(std::memory_order_relaxed);
+        size_type next = increment(t);
+
+        if(next == m_tail.cached)
+        {
+            m_tail.cached = m_head.value.load(std::memory_order_acquire);
+
+            if(next == m_tail.cached) return NULLPTR;
+        }
+
+        return slot(t);
+    }
+
+    void publish_tail()
+    {
+        size_type t = m_tail.value.load(std::memory_order_relaxed);
+
+        m_tail.value.store(increment(t), std::memory_order_release);
+    }
+
+public:
+    SpscRing() {}
+
+    SpscRing(const SpscRing&) = delete;
+    SpscRing& operator=(const SpscRing&) = delete;
+
+    ~SpscRing()
+    {
+        while(!empty()) pop();
+    }
+
+    static CONSTEXPR size_type capacity() { return N; }
+
+    // consumer side
+    bool empty() const
+    {
+        size_type h = m_head.value.load(std::memory_order_relaxed);
+
+        if(h != m_head.cached) return false;
+
+        m_head.cached = m_tail.value.load(std::memory_order_acquire);
+
+        return h == m_head.cached;
+    }
+
+    // producer side
+    bool full() const
+    {
+        size_type next = increment(m_tail.value.load(std::memory_order_relaxed));
+
+        if(next != m_tail.cached) return false;
+
+        m_tail.cached = m_head.value.load(std::memory_order_acquire);
+
+        return next == m_tail.cached;
+    }
+
+    // approximate when called while other side is active
+    size_type size() const
+    {
+        return used_between(m_head.value.load(std::memory_order_acquire),
+            m_tail.value.load(std::memory_order_acquire));
+    }
+
+    ///
+    /// \brief producer side: constructs new item at back of queue
+    /// \return item just queued, or null if queue was full
+    ///
+    template <class ...TArgs>
+    T* try_emplace(TArgs&&...args)
+    {
+        T* p = acquire_tail();
+
+        if(p == NULLPTR) return NULLPTR;
+
+        new (p) T(std::forward<TArgs>(args)...);
+
+        publish_tail();
+
+        return p;
+    }
+
+    /// producer side.  Waits (yielding) for consumer to pop if queue is full.
+    /// NOTE: once this returns consumer may already be working on (or even have
+    /// popped) the returned item
+    template <class ...TArgs>
+    T& emplace(TArgs&&...args)
+    {
+        T* p;
+
+        while((p = try_emplace(std::forward<TArgs>(args)...)) == NULLPTR)
+            std::this_thread::yield();
+
+        return *p;
+    }
+
+    bool push(const T& value)
+    {
+        return try_emplace(value) != NULLPTR;
+    }
+
+    // producer side: most recently queued item.  Same caveat as emplace()
+    T& back()
+    {
+        size_type t = m_tail.value.load(std::memory_order_relaxed);
+
+        return *slot(t == 0 ? slots - 1 : t - 1);
+    }
+
+    // consumer side.  Queue must not be empty
+    T& front()
+    {
+        return *slot(m_head.value.load(std::memory_order_relaxed));
+    }
+
+    // consumer side.  Queue must not be empty
+    void pop()
+    {
+        size_type h = m_head.value.load(std::memory_order_relaxed);
+
+        slot(h)->~T();
+
+        m_head.value.store(increment(h), std::memory_order_release);
+    }
+
+    ///
+    /// \brief producer side: constructs up to count items, publishing them all at once
+    /// \param f invoked as f(void* storage, size_t i) and must placement new item i
+    /// \return number of items constructed, fewer than count only if queue filled up
+    ///
+    template <class F>
+    size_type emplace_bulk(size_type count, F f)
+    {
+        size_type t = m_tail.value.load(std::memory_order_relaxed);
+
+        if(free_between(m_tail.cached, t) < count)
+            m_tail.cached = m_head.value.load(std::memory_order_acquire);
+
+        size_type available = free_between(m_tail.cached, t);
+
+        if(count > available) count = available;
+
+        for(size_type i = 0; i < count; i++)
+        {
+            f(static_cast<void*>(slot(t)), i);
+            t = increment(t);
+        }
+
+        if(count > 0) m_tail.value.store(t, std::memory_order_release);
+
+        return count;
+    }
+
+    ///
+    /// \brief consumer side: oldest max items (or fewer, if fewer are queued)
+    ///
+    /// Items remain queued until release_bulk
+    /// \return number of items placed into 'items'
+    ///
+    size_type claim_bulk(T** items, size_type max)
+    {
+        size_type h = m_head.value.load(std::memory_order_relaxed);
+
+        if(used_between(h, m_head.cached) < max)
+            m_head.cached = m_tail.value.load(std::memory_order_acquire);
+
+        size_type available = used_between(h, m_head.cached);
+
+        if(max > available) max = available;
+
+        for(size_type i = 0; i < max; i++)
+        {
+            items[i] = slot(h);
+            h = increment(h);
+        }
+
+        return max;
+    }
+
+    // consumer side: pops count items obtained from claim_bulk, all at once
+    void release_bulk(T**, size_type count)
+    {
+        size_type h = m_head.value.load(std::memory_order_relaxed);
+
+        for(size_type i = 0; i < count; i++)
+        {
+            slot(h)->~T();
+            h = increment(h);
+        }
+
+        m_head.value.store(h, std::memory_order_release);
+    }
+};
+
+///
+/// \brief bounded multi-producer/multi-consumer ring (Dmitry Vyukov's design)
+///
+/// Each cell carries a sequence number telling whether it's ready to be written
+/// (seq == pos) or read (seq == pos + 1) for a given lap, so producers and consumers
+/// each contend only on a single CAS of their own position counter.
+///
+/// Consumers claim() a cell and may work on its item in place for as long as they
+/// like, then release() it back to producers.  Other consumers carry on claiming
+/// subsequent cells in the meantime
+///
+template <class T, size_t N>
+class MpmcRing
+{
+public:
+    typedef T value_type;
+    typedef T& reference;
+    typedef size_t size_type;
+
+private:
+    typedef typename std::aligned_storage<sizeof(T), alignof(T)>::type storage_type;
+
+    struct Cell
+    {
+        // first, so that a T* handed out by claim() is also its Cell*
+        storage_type storage;
+        std::atomic<size_type> seq;
+    };
+
+    alignas(EMBR_CACHE_LINE_SIZE) std::atomic<size_type> m_enqueue_pos;
+    alignas(EMBR_CACHE_LINE_SIZE) std::atomic<size_type> m_dequeue_pos;
+    alignas(EMBR_CACHE_LINE_SIZE) Cell m_cells[N];
+
+    static T* item(Cell* c) { return reinterpret_cast<T*>(&c->storage); }
+
+    // producer side
+    Cell* acquire_enqueue()
+    {
+        size_type pos = m_enqueue_pos.load(std::memory_order_relaxed);
+
+        for(;;)
+        {
+            Cell* c = &m_cells[pos % N];
+            size_type seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+            if(diff == 0)
+            {
+                if(m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return c;
+            }
+            // cell still occupied from previous lap: full
+            else if(diff < 0)
+                return NULLPTR;
+            else
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // advances 'position' past the longest run (up to max) of cells whose seq is
+    // position + offset, i.e. ready for enqueue (offset 0) or dequeue (offset 1)
+    // \return length of run, whose start is placed in 'start'
+    size_type reserve_run(std::atomic<size_type>& position, size_type offset,
+        size_type max, size_type* start)
+    {
+        if(max > N) max = N;
+
+        if(max == 0) return 0;
+
+        size_type pos = position.load(std::memory_order_relaxed);
+
+        for(;;)
+        {
+            size_type n = 0;
+
+            while(n < max &&
+                m_cells[(pos + n) % N].seq.load(std::memory_order_acquire) == pos + n + offset)
+                n++;
+
+            if(n == 0)
+            {
+                size_type seq = m_cells[pos % N].seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + offset);
+
+                // full or empty, as the case may be
+                if(diff < 0) return 0;
+
+                pos = position.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if(position.compare_exchange_weak(pos, pos + n, std::memory_order_relaxed))
+            {
+                *start = pos;
+                return n;
+            }
+        }
+    }
+
+public:
+    MpmcRing() :
+        m_enqueue_pos(0),
+        m_dequeue_pos(0)
+    {
+        for(size_type i = 0; i < N; i++)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpmcRing(const MpmcRing&) = delete;
+    MpmcRing& operator=(const MpmcRing&) = delete;
+
+    ~MpmcRing()
+    {
+        T* p;
+
+        while((p = try_claim()) != NULLPTR) release(p);
+    }
+
+    static CONSTEXPR size_type capacity() { return N; }
+
+    // approximate when called while others are active
+    bool empty() const { return size() == 0; }
+
+    // approximate when called while others are active
+    size_type size() const
+    {
+        size_type d = m_dequeue_pos.load(std::memory_order_acquire);
+        size_type e = m_enqueue_pos.load(std::memory_order_acquire);
+
+        return e > d ? e - d : 0;
+    }
+
+    ///
+    /// \brief constructs new item at back of queue
+    /// \return item just queued, or null if queue was full
+    ///
+    template <class ...TArgs>
+    T* try_emplace(TArgs&&...args)
+    {
+        Cell* c = acquire_enqueue();
+
+        if(c == NULLPTR) return NULLPTR;
+
+        T* p = new (&c->storage) T(std::forward<TArgs>(args)...);
+
+        c->seq.store(c->seq.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        return p;
+    }
+
+    /// Waits (yielding) for a consumer to free up a cell if queue is full.
+    /// NOTE: once this returns a consumer may already be working on (or even have
+    /// released) the returned item
+    template <class ...TArgs>
+    T& emplace(TArgs&&...args)
+    {
+        T* p;
+
+        while((p = try_emplace(std::forward<TArgs>(args)...)) == NULLPTR)
+            std::this_thread::yield();
+
+        return *p;
+    }
+
+    bool push(const T& value)
+    {
+        return try_emplace(value) != NULLPTR;
+    }
+
+    ///
+    /// \brief takes exclusive hold of oldest item
+    /// \return item, which must eventually be handed to release(), or null if queue is empty
+    ///
+    T* try_claim()
+    {
+        size_type pos = m_dequeue_pos.load(std::memory_order_relaxed);
+
+        for(;;)
+        {
+            Cell* c = &m_cells[pos % N];
+            size_type seq = c->seq.load(std::memory_order_acquire);
+            intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+            if(diff == 0)
+            {
+                if(m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return item(c);
+            }
+            else if(diff < 0)
+                return NULLPTR;
+            else
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        }
+    }
+
+    // destroys claimed item and hands its cell back to producers for next lap
+    void release(T* p)
+    {
+        Cell* c = reinterpret_cast<Cell*>(p);
+
+        p->~T();
+
+        // claimed at pos where seq == pos + 1.  Ready for write at pos + N
+        c->seq.store(c->seq.load(std::memory_order_relaxed) - 1 + N, std::memory_order_release);
+    }
+
+    ///
+    /// \brief constructs up to count items, reserving their cells with a single CAS
+    /// \param f invoked as f(void* storage, size_t i) and must placement new item i
+    /// \return number of items constructed, fewer than count only if queue filled up
+    ///
+    template <class F>
+    size_type emplace_bulk(size_type count, F f)
+    {
+        size_type pos;
+        size_type n = reserve_run(m_enqueue_pos, 0, count, &pos);
+
+        for(size_type i = 0; i < n; i++)
+        {
+            Cell* c = &m_cells[(pos + i) % N];
+
+            f(static_cast<void*>(&c->storage), i);
+            c->seq.store(pos + i + 1, std::memory_order_release);
+        }
+
+        return n;
+    }
+
+    ///
+    /// \brief try_claim for up to max consecutive items, with a single CAS
+    /// \return number of items placed into 'items'
+    ///
+    size_type claim_bulk(T** items, size_type max)
+    {
+        size_type pos;
+        size_type n = reserve_run(m_dequeue_pos, 1, max, &pos);
+
+        for(size_type i = 0; i < n; i++)
+            items[i] = item(&m_cells[(pos + i) % N]);
+
+        return n;
+    }
+
+    void release_bulk(T** items, size_type count)
+    {
+        for(size_type i = 0; i < count; i++) release(items[i]);
+    }
+};
+
+/// Tally which any number of threads may bump at once.  Relaxed, since it orders
+/// nothing else
+class RelaxedCounter
+{
+    std::atomic<uint32_t> value;
+
+public:
+    RelaxedCounter() : value(0) {}
+
+    RelaxedCounter(const RelaxedCounter&) = delete;
+    RelaxedCounter& operator=(const RelaxedCounter&) = delete;
+
+    uint32_t operator++(int) { return value.fetch_add(1, std::memory_order_relaxed); }
+
+    operator uint32_t() const { return value.load(std::memory_order_relaxed); }
+};
+
+namespace internal {
+
+// calls f(), yielding in between, until it returns non null or timeout_ms elapses.
+// Deadline is fixed up front, so repeated failures don't extend the wait
+// \return final f() result
+template <class F>
+auto try_until(F f, unsigned timeout_ms) -> decltype(f())
+{
+    typedef std::chrono::steady_clock clock_type;
+
+    const clock_type::time_point deadline = clock_type::now() +
+        std::chrono::milliseconds(timeout_ms);
+
+    decltype(f()) result;
+
+    while((result = f()) == NULLPTR)
+    {
+        if(clock_type::now() >= deadline) break;
+
+        std::this_thread::yield();
+    }
+
+    return result;
+}
+
+}
+
+}
+
+///
+/// DataPump queue policy for when exactly one thread feeds each queue and exactly one
+/// (possibly other) thread drains it - typically transport_in() from the network stack
+/// and service() from an application task
+///
+template <size_t queue_depth = 10, size_t outgoing_queue_depth = queue_depth>
+struct SpscQueuePolicy
+{
+    static const size_t incoming_depth = queue_depth;
+    static const size_t outgoing_depth = outgoing_queue_depth;
+    // producer is typically network stack thread, which mustn't be held up - so waiting
+    // for room (QueueOverflowBlock) is opt in
+    static const QueueOverflow default_overflow = QueueOverflowReject;
+    // producer and consumer side (via drop strategies) may both tally
+    typedef BasicQueueCounters<experimental::RelaxedCounter> counters_type;
+
+    template <class TItem, size_t depth = queue_depth>
+    struct Queue
+    {
+        typedef TItem value_type;
+        typedef experimental::SpscRing<value_type, depth> queue_type;
+
+        static value_type& front(queue_type& queue)
+        {
+            return queue.front();
+        }
+
+        template <class ...TArgs>
+        static value_type& emplace(queue_type& queue, TArgs&&... args)
+        {
+            return queue.emplace(std::forward<TArgs>(args)...);
+        }
+
+        template <class ...TArgs>
+        static value_type* try_emplace(queue_type& queue, TArgs&&... args)
+        {
+            return queue.try_emplace(std::forward<TArgs>(args)...);
+        }
+
+        // only the consumer may pop
+        static bool drop_oldest(queue_type&)
+        {
+            return false;
+        }
+
+        // \return null, leaving args untouched, if queue is still full after timeout_ms
+        template <class ...TArgs>
+        static value_type* try_emplace_for(queue_type& queue, unsigned timeout_ms, TArgs&&... args)
+        {
+            return experimental::internal::try_until(
+                [&]() { return queue.try_emplace(std::forward<TArgs>(args)...); }, timeout_ms);
+        }
+
+        static value_type* claim(queue_type& queue)
+        {
+            return queue.empty() ? NULLPTR : &queue.front();
+        }
+
+        static void release(queue_type& queue, value_type*)
+        {
+            queue.pop();
+        }
+
+        static size_t claim_bulk(queue_type& queue, value_type** items, size_t max)
+        {
+            return queue.claim_bulk(items, max);
+        }
+
+        static void release_bulk(queue_type& queue, value_type** items, size_t count)
+        {
+            queue.release_bulk(items, count);
+        }
+
+        template <class TArg1, class TArg2>
+        static size_t emplace_bulk(queue_type& queue, TArg1* arg1, const TArg2* arg2, size_t count)
+        {
+            return queue.emplace_bulk(count, [&](void* storage, size_t i)
+            {
+                new (storage) value_type(std::move(arg1[i]), arg2[i]);
+            });
+        }
+    };
+};
+
+
+template <size_t queue_depth = 10, size_t outgoing_queue_depth = queue_depth>
+struct EmptyAppDataSpscQueuePolicy :
+        SpscQueuePolicy<queue_depth, outgoing_queue_depth>
+{
+    template <class TTransportDescriptor>
+    struct AppData {};
+};
+
+
+
+///
+/// DataPump queue policy permitting any number of threads to transport_in()/enqueue_out()
+/// and service() at once.  Only claim/release style access (dequeue_claim, transport_claim,
+/// as used by DataPort::service) is supported
+///
+template <size_t queue_depth = 10, size_t outgoing_queue_depth = queue_depth>
+struct MpmcQueuePolicy
+{
+    static const size_t incoming_depth = queue_depth;
+    static const size_t outgoing_depth = outgoing_queue_depth;
+    // as with SpscQueuePolicy, waiting for room (QueueOverflowBlock) is opt in
+    static const QueueOverflow default_overflow = QueueOverflowReject;
+    // any number of producers tally at once
+    typedef BasicQueueCounters<experimental::RelaxedCounter> counters_type;
+
+    template <class TItem, size_t depth = queue_depth>
+    struct Queue
+    {
+        typedef TItem value_type;
+        typedef experimental::MpmcRing<value_type, depth> queue_type;
+
+        template <class ...TArgs>
+        static value_type& emplace(queue_type& queue, TArgs&&... args)
+        {
+            return queue.emplace(std::forward<TArgs>(args)...);
+        }
+
+        template <class ...TArgs>
+        static value_type* try_emplace(queue_type& queue, TArgs&&... args)
+        {
+            return queue.try_emplace(std::forward<TArgs>(args)...);
+        }
+
+        // any thread may consume, so producer can discard oldest itself
+        static bool drop_oldest(queue_type& queue)
+        {
+            value_type* oldest = queue.try_claim();
+
+            if(oldest == NULLPTR) return false;
+
+            queue.release(oldest);
+            return true;
+        }
+
+        // size() can't be used to judge room, since a cell claimed but not yet released
+        // is neither counted nor available.  So keep trying the emplace itself
+        // \return null, leaving args untouched, if queue is still full after timeout_ms
+        template <class ...TArgs>
+        static value_type* try_emplace_for(queue_type& queue, unsigned timeout_ms, TArgs&&... args)
+        {
+            return experimental::internal::try_until(
+                [&]() { return queue.try_emplace(std::forward<TArgs>(args)...); }, timeout_ms);
+        }
+
+        static value_type* claim(queue_type& queue)
+        {
+            return queue.try_claim();
+        }
+
+        static void release(queue_type& queue, value_type* item)
+        {
+            queue.release(item);
+        }
+
+        static size_t claim_bulk(queue_type& queue, value_type** items, size_t max)
+        {
+            return queue.claim_bulk(items, max);
+        }
+
+        static void release_bulk(queue_type& queue, value_type** items, size_t count)
+        {
+            queue.release_bulk(items, count);
+        }
+
+        template <class TArg1, class TArg2>
+        static size_t emplace_bulk(queue_type& queue, TArg1* arg1, const TArg2* arg2, size_t count)
+        {
+            return queue.emplace_bulk(count, [&](void* storage, size_t i)
+            {
+                new (storage) value_type(std::move(arg1[i]), arg2[i]);
+            });
+        }
+    };
+};
+
+
+template <size_t queue_depth = 10, size_t outgoing_queue_depth = queue_depth>
+struct EmptyAppDataMpmcQueuePolicy :
+        MpmcQueuePolicy<queue_depth, outgoing_queue_depth>
+{
+    template <class TTransportDescriptor>
+    struct AppData {};
+};
+
+}
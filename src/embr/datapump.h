@@ -7,6 +7,8 @@
 #include <estd/queue.h>
 #include <estd/vector.h>
 
+#include <stdint.h>
+
 #ifdef FEATURE_CPP_MOVESEMANTIC
 #include <estd/utility.h> // for std::forward
 
@@ -36,12 +38,102 @@ namespace embr {
 #endif
 #endif
 
-template <size_t queue_depth = 10>
+// Inline or not, queue policies emplace and DataPump::enqueue forwards netbufs through
+// to them.  Non inline mode (items point to caller's netbuf) remains, but as a C++11
+// configuration selected with ENABLE_EMBR_DATAPUMP_INLINE=false
+#if !defined(FEATURE_CPP_MOVESEMANTIC) || !defined(FEATURE_CPP_VARIADIC)
+#error DataPump requires move semantic and variadic template support
+#endif
+
+// What DataPump does when asked to queue into a full queue
+enum QueueOverflow
+{
+    // item is left with caller, who gets QueueRejected
+    QueueOverflowReject,
+    // item is discarded
+    QueueOverflowDropNewest,
+    // oldest queued item is discarded to make room.  Not possible from producer side of
+    // a single consumer queue, so such queues reject instead
+    QueueOverflowDropOldest,
+    // wait up to a timeout for consumer to make room, then reject.  Only meaningful for
+    // thread safe queue policies - others reject right away
+    QueueOverflowBlock
+};
+
+enum QueueStatus
+{
+    QueueOK = 0,
+    // queued, at the expense of the oldest item
+    QueueOKDroppedOldest,
+
+    QueueDroppedNewest,
+    QueueRejected,
+    QueueTimedOut
+};
+
+// running tallies of what a DataPump queue has turned away
+/// \tparam TCounter plain integer, or for queues several producers feed at once, something
+/// which is safe to increment concurrently (see experimental::RelaxedCounter)
+template <class TCounter>
+struct BasicQueueCounters
+{
+    TCounter dropped_newest;
+    TCounter dropped_oldest;
+    TCounter rejected;
+    TCounter timed_out;
+
+    BasicQueueCounters() :
+        dropped_newest(),
+        dropped_oldest(),
+        rejected(),
+        timed_out()
+    {}
+
+    // snapshot of another flavor of counters
+    template <class TCounter2>
+    BasicQueueCounters(const BasicQueueCounters<TCounter2>& copy_from) :
+        dropped_newest(copy_from.dropped_newest),
+        dropped_oldest(copy_from.dropped_oldest),
+        rejected(copy_from.rejected),
+        timed_out(copy_from.timed_out)
+    {}
+};
+
+typedef BasicQueueCounters<uint32_t> QueueCounters;
+
+namespace internal {
+
+template <class T>
+struct always_void { typedef void type; };
+
+// TPolicy::counters_type if it has one, otherwise plain QueueCounters
+template <class TPolicy, class Enabled = void>
+struct queue_counters
+{
+    typedef QueueCounters type;
+};
+
+template <class TPolicy>
+struct queue_counters<TPolicy, typename always_void<typename TPolicy::counters_type>::type>
+{
+    typedef typename TPolicy::counters_type type;
+};
+
+}
+
+/// \tparam queue_depth capacity of receive-from-transport queue
+/// \tparam outgoing_queue_depth capacity of send-to-transport queue
+template <size_t queue_depth = 10, size_t outgoing_queue_depth = queue_depth>
 struct InlineQueuePolicy
 {
+    static const size_t incoming_depth = queue_depth;
+    static const size_t outgoing_depth = outgoing_queue_depth;
+    // what DataPump does with a full queue until told otherwise
+    static const QueueOverflow default_overflow = QueueOverflowReject;
+
     // Utilizing front/emplace helpers so that we can use aligned_storage more
     // transparently and only if necessary (some containers may not require it)
-    template <class TItem>
+    template <class TItem, size_t depth = queue_depth>
     struct Queue
     {
         // guidance from https://en.cppreference.com/w/cpp/types/aligned_storage
@@ -49,10 +141,10 @@ struct InlineQueuePolicy
         typedef TItem value_type;
 #ifdef FEATURE_CPP_ALIGN
         typedef estd::queue<value_type,
-            estd::layer1::deque<value_type, queue_depth,
+            estd::layer1::deque<value_type, depth,
             estd::experimental::aligned_storage_array_policy> > queue_type;
 #else
-        typedef estd::layer1::queue<value_type, queue_depth> queue_type;
+        typedef estd::layer1::queue<value_type, depth> queue_type;
 #endif
 
         static value_type& front(queue_type& queue)
@@ -65,6 +157,70 @@ struct InlineQueuePolicy
         {
             return queue.emplace(std::forward<TArgs&&>(args)...);
         }
+
+        // \return null, leaving args untouched, if queue is full
+        template <class ...TArgs>
+        static value_type* try_emplace(queue_type& queue, TArgs&&... args)
+        {
+            if(queue.size() >= depth) return NULLPTR;
+
+            return &queue.emplace(std::forward<TArgs&&>(args)...);
+        }
+
+        static bool drop_oldest(queue_type& queue)
+        {
+            if(queue.empty()) return false;
+
+            queue.pop();
+            return true;
+        }
+
+        // nobody else could be making room, so no sense waiting
+        template <class ...TArgs>
+        static value_type* try_emplace_for(queue_type& queue, unsigned, TArgs&&... args)
+        {
+            return try_emplace(queue, std::forward<TArgs>(args)...);
+        }
+
+        // takes exclusive hold of front item for processing, null if queue is empty.
+        // No synchronization here, so only one consumer may claim at a time
+        static value_type* claim(queue_type& queue)
+        {
+            return queue.empty() ? NULLPTR : &queue.front();
+        }
+
+        // done processing claimed item, removes it from queue
+        static void release(queue_type& queue, value_type*)
+        {
+            queue.pop();
+        }
+
+        // underlying deque can't hand out more than its front, so bulk claims are
+        // one at a time
+        static size_t claim_bulk(queue_type& queue, value_type** items, size_t max)
+        {
+            if(max == 0 || queue.empty()) return 0;
+
+            items[0] = &queue.front();
+            return 1;
+        }
+
+        static void release_bulk(queue_type& queue, value_type**, size_t count)
+        {
+            while(count--) queue.pop();
+        }
+
+        // constructs value_type(std::move(arg1[i]), arg2[i]) for as many as fit
+        template <class TArg1, class TArg2>
+        static size_t emplace_bulk(queue_type& queue, TArg1* arg1, const TArg2* arg2, size_t count)
+        {
+            size_t i = 0;
+
+            for(; i < count && queue.size() < depth; i++)
+                queue.emplace(std::move(arg1[i]), arg2[i]);
+
+            return i;
+        }
     };
 };
 
@@ -209,22 +365,75 @@ public:
 
 
 private:
-    typedef typename policy_type::template Queue<Item> queue_policy;
-    typedef typename queue_policy::queue_type queue_type;
+    typedef typename policy_type::template Queue<Item, policy_type::incoming_depth> incoming_policy;
+    typedef typename policy_type::template Queue<Item, policy_type::outgoing_depth> outgoing_policy;
 
-    queue_type incoming;
-    queue_type outgoing;
+    struct Overflow
+    {
+        QueueOverflow strategy;
+        // for QueueOverflowBlock
+        unsigned timeout_ms;
+        // thread safe queue policies supply counters several producers may bump at once
+        typename internal::queue_counters<policy_type>::type counters;
+
+        // all ones timeout is, practically speaking, wait forever
+        Overflow() :
+            strategy(policy_type::default_overflow),
+            timeout_ms(~0U)
+        {}
+    };
+
+    typename incoming_policy::queue_type incoming;
+    typename outgoing_policy::queue_type outgoing;
+
+    Overflow incoming_overflow;
+    Overflow outgoing_overflow;
+
+    // queues item, applying overflow strategy if queue is full
+    template <class TQueuePolicy, class TNetBuf>
+    static const Item* enqueue(typename TQueuePolicy::queue_type& queue, Overflow& overflow,
+        TNetBuf&& netbuf, const addr_t& addr, QueueStatus* status);
 
 public:
-    // process data coming in from transport into coap queue
+    typedef typename internal::queue_counters<policy_type>::type counters_type;
+
+    ///
+    /// \brief process data coming in from transport into coap queue
+    /// \param status if provided, receives outcome, including what overflow strategy did
+    /// \return item queued, or null if incoming queue was full and overflow strategy
+    /// didn't make room.  NOTE: formerly returned const Item&, which a full queue
+    /// gave no way to honor
+    /// NOTE: with thread safe queue policies, a consumer may already be working on the item
+    ///
 #if ENABLE_EMBR_DATAPUMP_INLINE
-    const Item& transport_in(
+    const Item* transport_in(
             netbuf_type&& in,
 #else
-    const Item& transport_in(
+    const Item* transport_in(
             netbuf_type& in,
 #endif
-            const addr_t& addr);
+            const addr_t& addr,
+            QueueStatus* status = NULLPTR);
+
+    // what to do when transport_in finds incoming queue full
+    void incoming_overflow_strategy(QueueOverflow strategy, unsigned timeout_ms = 0)
+    {
+        incoming_overflow.strategy = strategy;
+        incoming_overflow.timeout_ms = timeout_ms;
+    }
+
+    // what to do when enqueue_out finds outgoing queue full
+    void outgoing_overflow_strategy(QueueOverflow strategy, unsigned timeout_ms = 0)
+    {
+        outgoing_overflow.strategy = strategy;
+        outgoing_overflow.timeout_ms = timeout_ms;
+    }
+
+    const counters_type& incoming_counters() const { return incoming_overflow.counters; }
+    const counters_type& outgoing_counters() const { return outgoing_overflow.counters; }
+
+    static CONSTEXPR size_t incoming_capacity() { return policy_type::incoming_depth; }
+    static CONSTEXPR size_t outgoing_capacity() { return policy_type::outgoing_depth; }
 
     // ascertain whether any -> transport outgoing netbufs are present
     bool transport_empty() const
@@ -234,7 +443,7 @@ public:
 
     Item& transport_front()
     {
-        return queue_policy::front(outgoing);
+        return outgoing_policy::front(outgoing);
     }
 
     void transport_pop()
@@ -242,25 +451,102 @@ public:
         outgoing.pop();
     }
 
+    ///
+    /// \brief enqueue complete netbuf for outgoing transport to pick up
+    /// \return item queued, or null if outgoing queue was full and overflow strategy
+    /// didn't make room.  NOTE: formerly returned const Item&
+    ///
 #if ENABLE_EMBR_DATAPUMP_INLINE
-    // enqueue complete netbuf for outgoing transport to pick up
-    const Item& enqueue_out(netbuf_type&& out, const addr_t& addr_out)
+    const Item* enqueue_out(netbuf_type&& out, const addr_t& addr_out, QueueStatus* status = NULLPTR)
     {
-        return queue_policy::emplace(outgoing, std::move(out), addr_out);
+        return enqueue<outgoing_policy>(outgoing, outgoing_overflow, std::move(out), addr_out, status);
     }
 #else
-    // enqueue complete netbuf for outgoing transport to pick up
-    const Item& enqueue_out(netbuf_type& out, const addr_t& addr_out)
+    const Item* enqueue_out(netbuf_type& out, const addr_t& addr_out, QueueStatus* status = NULLPTR)
     {
-        outgoing.push(Item(out, addr_out));
-        return outgoing.back();
+        return enqueue<outgoing_policy>(outgoing, outgoing_overflow, out, addr_out, status);
     }
 #endif
 
+    // claims next outgoing item for exclusive sending.  Unlike transport_front/transport_pop,
+    // safe to use from multiple threads at once when queue policy is (i.e. MpmcQueuePolicy)
+    // \return null if nothing is queued for transport
+    Item* transport_claim()
+    {
+        return outgoing_policy::claim(outgoing);
+    }
+
+    // done sending item obtained from transport_claim
+    void transport_release(Item* item)
+    {
+        outgoing_policy::release(outgoing, item);
+    }
+
+#if ENABLE_EMBR_DATAPUMP_INLINE
+    ///
+    /// \brief enqueues up to count netbufs for outgoing transport in one go
+    ///
+    /// netbufs are moved from.  Thread safe queue policies publish the whole batch with
+    /// one round of synchronization rather than one per item.  Overflow strategy is not
+    /// applied; netbufs beyond what fit are left with caller
+    /// \return number enqueued, fewer than count only if queue filled up
+    ///
+    size_t enqueue_bulk(netbuf_type* netbufs, const addr_t* addrs, size_t count)
+    {
+        return outgoing_policy::emplace_bulk(outgoing, netbufs, addrs, count);
+    }
+#endif
+
+    // transport_claim for up to max items at once
+    // \return number of items claimed into 'items'
+    size_t transport_claim_bulk(Item** items, size_t max)
+    {
+        return outgoing_policy::claim_bulk(outgoing, items, max);
+    }
+
+    // done sending all count items obtained from transport_claim_bulk
+    void transport_release_bulk(Item** items, size_t count)
+    {
+        outgoing_policy::release_bulk(outgoing, items, count);
+    }
+
     // see if any netbufs were queued from transport in
     bool dequeue_empty() const { return incoming.empty(); }
 
-    Item& dequeue_front() { return queue_policy::front(incoming); }
+    ///
+    /// \brief dequeue_claim for up to max items at once
+    ///
+    /// Thread safe queue policies claim the whole run with one round of synchronization
+    /// rather than one per item
+    /// \return number of items claimed into 'items', 0 if nothing is queued from transport
+    ///
+    size_t dequeue_bulk(Item** items, size_t max)
+    {
+        return incoming_policy::claim_bulk(incoming, items, max);
+    }
+
+    // done processing all count items obtained from dequeue_bulk
+    void dequeue_release_bulk(Item** items, size_t count)
+    {
+        incoming_policy::release_bulk(incoming, items, count);
+    }
+
+    // claims next item queued from transport in for exclusive processing.  Unlike
+    // dequeue_front/dequeue_pop, safe to use from multiple threads at once when
+    // queue policy is (i.e. MpmcQueuePolicy)
+    // \return null if nothing is queued from transport
+    Item* dequeue_claim()
+    {
+        return incoming_policy::claim(incoming);
+    }
+
+    // done processing item obtained from dequeue_claim
+    void dequeue_release(Item* item)
+    {
+        incoming_policy::release(incoming, item);
+    }
+
+    Item& dequeue_front() { return incoming_policy::front(incoming); }
 
     // TODO: deprecated
     // dequeue complete netbuf which was queued from transport in
@@ -268,7 +554,7 @@ public:
     {
         if(incoming.empty()) return NULLPTR;
 
-        Item& f = queue_policy::front(incoming);
+        Item& f = incoming_policy::front(incoming);
         netbuf_type* netbuf = f.netbuf();
         *addr_in = f.addr();
 
@@ -3,21 +3,85 @@
 namespace embr {
 
 template <class TTransportDescriptor, class TPolicy>
-#ifdef FEATURE_EMBR_DATAPUMP_INLINE
-auto DataPump<TTransportDescriptor, TPolicy>::transport_in(netbuf_type&& in, const addr_t& addr) ->
-    const Item&
+template <class TQueuePolicy, class TNetBuf>
+auto DataPump<TTransportDescriptor, TPolicy>::enqueue(
+    typename TQueuePolicy::queue_type& queue, Overflow& overflow,
+    TNetBuf&& netbuf, const addr_t& addr, QueueStatus* status) ->
+    const Item*
 {
-    return incoming.emplace(std::move(in), addr);
+    QueueStatus s = QueueOK;
+    Item* item = TQueuePolicy::try_emplace(queue, std::forward<TNetBuf>(netbuf), addr);
+
+    if(item == NULLPTR)
+    {
+        switch(overflow.strategy)
+        {
+            case QueueOverflowDropNewest:
+            {
+#if ENABLE_EMBR_DATAPUMP_INLINE
+                // take it off caller's hands, as if it had been queued
+                netbuf_type discarded(std::move(netbuf));
+#endif
+                overflow.counters.dropped_newest++;
+                s = QueueDroppedNewest;
+                break;
+            }
+
+            case QueueOverflowDropOldest:
+                if(TQueuePolicy::drop_oldest(queue))
+                {
+                    overflow.counters.dropped_oldest++;
+                    item = TQueuePolicy::try_emplace(queue, std::forward<TNetBuf>(netbuf), addr);
+                }
+
+                if(item != NULLPTR)
+                    s = QueueOKDroppedOldest;
+                else
+                {
+                    overflow.counters.rejected++;
+                    s = QueueRejected;
+                }
+                break;
+
+            case QueueOverflowBlock:
+                // one deadline covers the whole wait, even if other producers keep
+                // beating us to the room made
+                item = TQueuePolicy::try_emplace_for(queue, overflow.timeout_ms,
+                    std::forward<TNetBuf>(netbuf), addr);
+
+                if(item == NULLPTR)
+                {
+                    overflow.counters.timed_out++;
+                    s = QueueTimedOut;
+                }
+                break;
+
+            default:
+                overflow.counters.rejected++;
+                s = QueueRejected;
+                break;
+        }
+    }
+
+    if(status != NULLPTR) *status = s;
+
+    return item;
+}
+
+template <class TTransportDescriptor, class TPolicy>
+#if ENABLE_EMBR_DATAPUMP_INLINE
+auto DataPump<TTransportDescriptor, TPolicy>::transport_in(netbuf_type&& in, const addr_t& addr,
+    QueueStatus* status) ->
+    const Item*
+{
+    return enqueue<incoming_policy>(incoming, incoming_overflow, std::move(in), addr, status);
 }
 #else
-const typename DataPump<TTransportDescriptor, TPolicy>::Item&
-    DataPump<TTransportDescriptor, TPolicy>::transport_in(netbuf_type& in, const addr_t& addr)
+const typename DataPump<TTransportDescriptor, TPolicy>::Item*
+    DataPump<TTransportDescriptor, TPolicy>::transport_in(netbuf_type& in, const addr_t& addr,
+        QueueStatus* status)
 {
-    Item item(in, addr);
-
-    incoming.push(item);
-
-    return incoming.back();
+    return enqueue<incoming_policy>(incoming, incoming_overflow, in, addr, status);
 }
 #endif
 
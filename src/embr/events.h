@@ -1,5 +1,7 @@
 #pragma once
 
+#include <stddef.h>
+
 namespace embr { namespace event {
 
 template <class TNetBuf, class TAddr>
@@ -101,6 +103,95 @@ struct ReceiveDequeued : ItemBase<TItem>
 };
 
 
+// a run of items pulled from a tx or rx queue together
+template <class TItem>
+struct ItemBatchBase
+{
+    TItem* const* items;
+    size_t count;
+
+    ItemBatchBase(TItem* const* items, size_t count) :
+        items(items),
+        count(count)
+    {}
+
+    TItem& operator[](size_t i) const { return *items[i]; }
+};
+
+
+// a batch of items from receive-from-transport queue being processed.  When
+// servicing in aggregate mode, fires in place of per-item ReceiveDequeuing/ReceiveDequeued
+// right after this, each TNetBuf will be deallocated
+template <class TItem>
+struct ReceiveBatchDequeued : ItemBatchBase<TItem>
+{
+    ReceiveBatchDequeued(TItem* const* items, size_t count) :
+        ItemBatchBase<TItem>(items, count) {}
+};
+
+
+// a batch of items just sent over transport.  When servicing in aggregate mode,
+// fires in place of per-item TransportSending/TransportSent/SendDequeued
+template <class TItem>
+struct SendBatchSent : ItemBatchBase<TItem>
+{
+    SendBatchSent(TItem* const* items, size_t count) :
+        ItemBatchBase<TItem>(items, count) {}
+};
+
+
+// a DataPump queue was full when asked to take another item
+template <class TCounters>
+struct QueueOverflowBase
+{
+    // true = receive-from-transport queue, false = send-to-transport queue
+    const bool incoming;
+    // running tallies for the queue in question, including this occurrence
+    const TCounters& counters;
+
+    QueueOverflowBase(bool incoming, const TCounters& counters) :
+        incoming(incoming),
+        counters(counters)
+    {}
+};
+
+
+// item being queued was discarded
+template <class TCounters>
+struct QueueDroppedNewest : QueueOverflowBase<TCounters>
+{
+    QueueDroppedNewest(bool incoming, const TCounters& counters) :
+        QueueOverflowBase<TCounters>(incoming, counters) {}
+};
+
+
+// oldest queued item was discarded to make room
+template <class TCounters>
+struct QueueDroppedOldest : QueueOverflowBase<TCounters>
+{
+    QueueDroppedOldest(bool incoming, const TCounters& counters) :
+        QueueOverflowBase<TCounters>(incoming, counters) {}
+};
+
+
+// item being queued was turned away and remains with caller
+template <class TCounters>
+struct QueueRejected : QueueOverflowBase<TCounters>
+{
+    QueueRejected(bool incoming, const TCounters& counters) :
+        QueueOverflowBase<TCounters>(incoming, counters) {}
+};
+
+
+// no room appeared within blocking timeout.  Item remains with caller
+template <class TCounters>
+struct QueueTimedOut : QueueOverflowBase<TCounters>
+{
+    QueueTimedOut(bool incoming, const TCounters& counters) :
+        QueueOverflowBase<TCounters>(incoming, counters) {}
+};
+
+
 template <class TTransportDescriptor>
 struct Transport
 {
@@ -137,6 +228,23 @@ struct Datapump
         send_queued;
     typedef SendDequeued<typename item_t::addr_t>
         send_dequeued;
+    typedef ReceiveBatchDequeued<item_t>
+        receive_batch_dequeued;
+    typedef SendBatchSent<item_t>
+        send_batch_sent;
+};
+
+template <class TCounters>
+struct DatapumpQueue
+{
+    typedef QueueDroppedNewest<TCounters>
+        queue_dropped_newest;
+    typedef QueueDroppedOldest<TCounters>
+        queue_dropped_oldest;
+    typedef QueueRejected<TCounters>
+        queue_rejected;
+    typedef QueueTimedOut<TCounters>
+        queue_timed_out;
 };
 
 
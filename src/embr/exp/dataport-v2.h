@@ -74,11 +74,21 @@ struct Dataport2 : DataportFnPtrImpl<TDatapumpWithRetry>
                 RetryEvaluating,    ///< TEST
         /// Indicates we no longer will attempt retries for this item
                 RetryDequeued,
+        /// item pool had to link in another slab to satisfy a queuing request.
+        /// Context carries item just allocated
+                ItemPoolGrew,
+        /// item pool had nothing left, so received pbuf was not queued.  Context carries
+        /// pbuf and addr, which remain listener's responsibility (i.e. to free)
+                TransportInPoolExhausted,
+        /// item pool had nothing left, so outgoing pbuf was not queued.  Context carries
+        /// pbuf and addr
+                TransportOutPoolExhausted,
     };
 
     // NOTE: Looking like we might not even need an instance field
     // for state here
-    State _state;
+    // NOTE: Initialized only so that first state() comparison is well defined
+    State _state = TransportInReceiving;
 
     struct NotifyEvent
     {
@@ -172,6 +182,31 @@ struct Dataport2 : DataportFnPtrImpl<TDatapumpWithRetry>
         state(s, &context);
     }
 
+    // like state(), but notifies even if already in state 's'.  For per-item events
+    // where listener has to hear about every item (i.e. to free it), however many
+    // arrive back to back
+    void signal(State s, NotifyContext* context)
+    {
+        _state = s;
+        notify(context);
+    }
+
+    void signal(State s, item_type* item, void* user)
+    {
+        NotifyContext context{ this, user, item };
+        signal(s, &context);
+    }
+
+    void signal(State s, pbuf_type pbuf, addr_type addr, void* user)
+    {
+        NotifyContext context{ this, user };
+
+        context.buf_addr.pbuf = pbuf;
+        context.buf_addr.addr = addr;
+
+        signal(s, &context);
+    }
+
     State state() const { return _state; }
 
     void process_from_transport(void* user = NULLPTR)
@@ -225,13 +260,35 @@ struct Dataport2 : DataportFnPtrImpl<TDatapumpWithRetry>
         state(TransportOutQueued, item, user);
     }
 
-    void process_retry(void* user = NULLPTR)
+    /// @brief queues up for send every retry item which has come due.  Those whose
+    /// retries are exhausted are given up on instead, signalled with RetryDequeued
+    /// \return number of items queued
+    size_t process_retry(void* user = NULLPTR)
     {
-        item_type* item_to_send = retry().dequeue_retry_ready();
+        typename retry_type::ready_list_type ready;
+        size_t count = 0;
+
+        retry().dequeue_retry_ready(retry_type::clock_type::now(), ready);
+
+        while(!ready.empty())
+        {
+            item_type* item = &ready.front();
+
+            // unlink first, since to transport queue reuses the same link
+            ready.pop_front();
 
-        if(item_to_send != NULLPTR)
-            // process_to_transport will handle requeuing portion
-            send_to_transport(item_to_send);
+            if(retry().should_resend(item))
+            {
+                // process_to_transport will handle requeuing portion
+                send_to_transport(item, user);
+                ++count;
+            }
+            else
+                // listener frees item, so every one must be heard about
+                signal(RetryDequeued, item, user);
+        }
+
+        return count;
     }
 
 
@@ -239,29 +296,63 @@ struct Dataport2 : DataportFnPtrImpl<TDatapumpWithRetry>
     {
         process_from_transport(user);
         process_retry(user);
-        process_to_transport(user);
+        // retries come due together, so send off all of them this pass rather
+        // than one per call
+        while(datapump().to_transport_ready())
+            process_to_transport(user);
     }
 
 
     /// @brief Queue up for send to transport
     /// \param pbuf
     /// \param to_address
-    void send_to_transport(pbuf_type& pbuf, addr_type to_address, void* user = NULLPTR)
+    /// \return PoolExhausted if nothing was queued
+    PoolStatus send_to_transport(pbuf_type& pbuf, addr_type to_address, void* user = NULLPTR)
     {
         // FIX: resolve descrepency between formats of TransportOutQueuing
         // by allocating an Item *here* instead of in the datapump helper function
-        item_type* item = datapump().allocate();
-        send_to_transport(item);
+        PoolStatus status;
+        item_type* item = datapump().allocate(&status);
+
+        if(item == NULLPTR)
+        {
+            // pbuf goes back to listener, so every failure must be heard about
+            signal(TransportOutPoolExhausted, pbuf, to_address, user);
+            return status;
+        }
+
+        if(status == PoolGrew) state(ItemPoolGrew, item, user);
+
+        item->pbuf = pbuf;
+        item->addr = to_address;
+
+        send_to_transport(item, user);
+
+        return status;
     }
 
     /// @brief called when transport receives data, to queue up in our datapump/dataport
     ///
     /// this is mainly for async calls.  Queues into from_transport queue
-    void received_from_transport(pbuf_type pbuf, addr_type from_address, void* user = NULLPTR)
+    /// \return PoolExhausted if nothing was queued
+    PoolStatus received_from_transport(pbuf_type pbuf, addr_type from_address, void* user = NULLPTR)
     {
+        PoolStatus status;
+
         state(TransportInQueueing, pbuf, from_address, user);
-        item_type* item = datapump().enqueue_from_transport(pbuf, from_address);
+        item_type* item = datapump().enqueue_from_transport(pbuf, from_address, &status);
+
+        if(item == NULLPTR)
+        {
+            signal(TransportInPoolExhausted, pbuf, from_address, user);
+            return status;
+        }
+
+        if(status == PoolGrew) state(ItemPoolGrew, item, user);
+
         state(TransportInQueued, item, user);
+
+        return status;
     }
 };
 
@@ -0,0 +1,236 @@
+/**
+ *  @file
+ *  Item pools for Datapump2
+ *
+ *  A pool policy supplies a nested Pool<TItem> which offers allocate/deallocate
+ *  along with capacity(), so that Datapump2 can tell when a pool grew
+ */
+#pragma once
+
+#include <estd/exp/memory_pool.h>
+
+#include <stdint.h>
+
+#include <memory>
+#include <new>
+
+namespace embr { namespace experimental {
+
+// Outcome of asking Datapump2 for an item
+enum PoolStatus
+{
+    PoolOK = 0,
+    // item was obtained, but only by linking in another slab
+    PoolGrew,
+    // no item available.  Nothing was queued
+    PoolExhausted
+};
+
+// running tallies to aid in sizing a pool to actual traffic
+struct PoolCounters
+{
+    // items presently handed out
+    size_t in_use;
+    // most items ever handed out at once
+    size_t high_water;
+    // allocations turned away
+    uint32_t exhausted;
+
+    PoolCounters() :
+        in_use(0),
+        high_water(0),
+        exhausted(0)
+    {}
+};
+
+
+/// Upstream allocator which reports failure with null rather than std::bad_alloc, so that
+/// a pool which can't grow comes back as PoolExhausted
+template <class T>
+struct NothrowAllocator
+{
+    typedef T value_type;
+
+    NothrowAllocator() {}
+
+    template <class U>
+    NothrowAllocator(const NothrowAllocator<U>&) {}
+
+    T* allocate(size_t n)
+    {
+        return static_cast<T*>(::operator new(n * sizeof(T), std::nothrow));
+    }
+
+    void deallocate(T* p, size_t) { ::operator delete(p); }
+};
+
+
+/// Fixed pool of pool_size items, all living inside Datapump2 itself
+template <size_t pool_size = 10>
+struct Datapump2FixedPoolPolicy
+{
+    template <class TItem>
+    struct Pool
+    {
+        // TODO: Right now, memory_pool_ll is going to impose its own linked list onto item
+        // but it would be nice to instead bring our own 'next()' calls and have memory_pool_ll
+        // be able to pick those up.  This should amount to refining memory_pool_ll's usage of
+        // node_traits
+        estd::experimental::memory_pool_ll<TItem, pool_size> pool;
+
+        // \return null when all pool_size items are in use
+        TItem* allocate() { return pool.allocate(); }
+
+        void deallocate(TItem* item) { pool.deallocate(item); }
+
+        static CONSTEXPR size_t capacity() { return pool_size; }
+    };
+};
+
+
+/// Starts with one slab of slab_size items living inside Datapump2, then links in further
+/// slab_size slabs from TUpstream as needed.  Slabs are kept until the pool itself goes away,
+/// so once warmed up (see reserve) allocate/deallocate are O(1) and heap-free
+/// \tparam max_slabs cap on slab count, including the initial one.  0 = no cap
+/// \tparam TUpstream uint8_t allocator which returns null when out of memory, rather than throwing
+template <size_t slab_size = 10, unsigned max_slabs = 0,
+          class TUpstream = NothrowAllocator<uint8_t> >
+struct Datapump2SegmentedPoolPolicy
+{
+    template <class TItem>
+    class Pool
+    {
+        typedef std::allocator_traits<TUpstream> upstream_traits;
+
+        // overlays an item's storage while it's free
+        union Node
+        {
+            Node* next;
+            alignas(TItem) unsigned char storage[sizeof(TItem)];
+        };
+
+        struct Slab
+        {
+            Slab* next;
+            Node nodes[slab_size];
+        };
+
+        Slab initial;
+        // most recently linked slab, from which never-yet-used nodes are carved
+        Slab* current;
+        // nodes of 'current' carved so far
+        size_t carved;
+        unsigned slabs;
+        Node* free_list;
+
+        bool grow()
+        {
+            if(max_slabs != 0 && slabs == max_slabs) return false;
+
+            TUpstream upstream;
+            void* p = upstream_traits::allocate(upstream, sizeof(Slab));
+
+            if(p == NULLPTR) return false;
+
+            Slab* slab = static_cast<Slab*>(p);
+
+            slab->next = current;
+            current = slab;
+            carved = 0;
+            ++slabs;
+
+            return true;
+        }
+
+        // pushes all of 'current's remaining uncarved nodes onto free list
+        void carve_remaining()
+        {
+            for(; carved < slab_size; ++carved)
+            {
+                Node* node = &current->nodes[carved];
+
+                node->next = free_list;
+                free_list = node;
+            }
+        }
+
+    public:
+        Pool() :
+            current(&initial),
+            carved(0),
+            slabs(1),
+            free_list(NULLPTR)
+        {
+            initial.next = NULLPTR;
+        }
+
+        // Items still out are not destructed, only their memory released
+        ~Pool()
+        {
+            TUpstream upstream;
+
+            while(current != &initial)
+            {
+                Slab* next = current->next;
+
+                upstream_traits::deallocate(upstream, reinterpret_cast<uint8_t*>(current),
+                    sizeof(Slab));
+                current = next;
+            }
+        }
+
+        Pool(const Pool&) = delete;
+        Pool& operator=(const Pool&) = delete;
+
+        // \return null when no free item remains and no further slab could be had
+        TItem* allocate()
+        {
+            Node* node = free_list;
+
+            if(node != NULLPTR)
+                free_list = node->next;
+            else
+            {
+                // cold path - only reached while pool is still growing
+                if(carved == slab_size && !grow()) return NULLPTR;
+
+                node = &current->nodes[carved++];
+            }
+
+            return new (node->storage) TItem();
+        }
+
+        void deallocate(TItem* item)
+        {
+            item->~TItem();
+
+            Node* node = reinterpret_cast<Node*>(item);
+
+            node->next = free_list;
+            free_list = node;
+        }
+
+        ///
+        /// \brief links in enough slabs up front to hold 'count' items in total
+        /// \return false if max_slabs or upstream stopped us short
+        ///
+        bool reserve(size_t count)
+        {
+            while(capacity() < count)
+            {
+                carve_remaining();
+
+                if(!grow()) return false;
+            }
+
+            return true;
+        }
+
+        size_t capacity() const { return slabs * slab_size; }
+
+        unsigned slab_count() const { return slabs; }
+    };
+};
+
+
+}}
@@ -10,9 +10,8 @@
 #include <estd/forward_list.h>
 #include <estd/chrono.h>
 #include <estd/optional.h>
-#include <estd/exp/memory_pool.h>
-
 #include "datapump-core-v2.h"
+#include "datapump-pool-v2.h"
 #include "pbuf.h"
 #include "retry-v2.h"
 
@@ -26,9 +25,11 @@ namespace embr { namespace experimental {
 // Would use transport descriptor, but:
 // a) it's a little more unweildy than expected
 // b) it's netbuf based, and this needs to be PBuf based
+/// \tparam TPoolPolicy where items come from - see datapump-pool-v2.h
 template <
         class TPBuf, class TAddr,
-        class TItem = Datapump2CoreItem<TPBuf, TAddr> >
+        class TItem = Datapump2CoreItem<TPBuf, TAddr>,
+        class TPoolPolicy = Datapump2FixedPoolPolicy<> >
 class Datapump2
 {
 public:
@@ -40,17 +41,15 @@ public:
     // TODO: Do static asserts to make sure we have at least conformance to Datapool2CoreItem
     typedef TItem item_type;
     typedef item_type* pointer;
+    typedef typename TPoolPolicy::template Pool<item_type> pool_type;
 
 #ifdef UNIT_TESTING
 public:
 #else
 private:
 #endif
-    // TODO: Right now, memory_pool_ll is going to impose its own linked list onto item
-    // but it would be nice to instead bring our own 'next()' calls and have memory_pool_ll
-    // be able to pick those up.  This should amount to refining memory_pool_ll's usage of
-    // node_traits
-    estd::experimental::memory_pool_ll<item_type, 10> pool;
+    pool_type pool;
+    PoolCounters _pool_counters;
 
     typedef estd::intrusive_forward_list_with_back<item_type> list_type;
 
@@ -60,16 +59,43 @@ private:
     typedef typename list_type::iterator iterator;
 
 public:
-    pointer allocate()
+    /// @brief obtain an item from pool
+    /// \param status if provided, receives whether pool had to grow or was exhausted
+    /// \return null if pool is exhausted
+    pointer allocate(PoolStatus* status = NULLPTR)
     {
-        return pool.allocate();
+        const size_t capacity = pool.capacity();
+        pointer item = pool.allocate();
+        PoolStatus s = PoolOK;
+
+        if(item == NULLPTR)
+        {
+            _pool_counters.exhausted++;
+            s = PoolExhausted;
+        }
+        else
+        {
+            if(++_pool_counters.in_use > _pool_counters.high_water)
+                _pool_counters.high_water = _pool_counters.in_use;
+
+            if(pool.capacity() != capacity) s = PoolGrew;
+        }
+
+        if(status != NULLPTR) *status = s;
+
+        return item;
     }
 
     void deallocate(pointer item)
     {
+        _pool_counters.in_use--;
         pool.deallocate(item);
     }
 
+    const PoolCounters& pool_counters() const { return _pool_counters; }
+
+    size_t pool_capacity() const { return pool.capacity(); }
+
 
     bool to_transport_ready() const
     {
@@ -86,14 +112,19 @@ public:
 #endif
     }
 
-    void enqueue_to_transport(TPBuf pbuf, addr_type from_address)
+    /// \return item queued, or null if pool is exhausted
+    pointer enqueue_to_transport(TPBuf pbuf, addr_type to_address, PoolStatus* status = NULLPTR)
     {
-        pointer item = allocate();
+        pointer item = allocate(status);
+
+        if(item == NULLPTR) return NULLPTR;
 
         item->pbuf = pbuf;
-        item->addr = from_address;
+        item->addr = to_address;
 
         enqueue_to_transport(item);
+
+        return item;
     }
 
     /// @brief dequeue item from transport output queue
@@ -121,9 +152,13 @@ public:
     }
 
 
-    pointer enqueue_from_transport(TPBuf pbuf, addr_type from_address)
+    /// \return item queued, or null if pool is exhausted - in which case
+    /// pbuf remains caller's responsibility
+    pointer enqueue_from_transport(TPBuf pbuf, addr_type from_address, PoolStatus* status = NULLPTR)
     {
-        pointer item = allocate();
+        pointer item = allocate(status);
+
+        if(item == NULLPTR) return NULLPTR;
 
         item->pbuf = pbuf;
         item->addr = from_address;
@@ -158,10 +193,12 @@ public:
 template <
         class TPBuf, class TAddr,
         class TRetryImpl = BasicRetry<TPBuf, TAddr>,
-        class TItem = typename TRetryImpl::RetryItem >
+        class TItem = typename TRetryImpl::RetryItem,
+        class TPoolPolicy = Datapump2FixedPoolPolicy<>,
+        class TSchedulerPolicy = RetryListPolicy>
 class DatapumpWithRetry2 :
-        public Datapump2<TPBuf, TAddr, TItem>,
-        public Retry2<TPBuf, TAddr, TRetryImpl, TItem>
+        public Datapump2<TPBuf, TAddr, TItem, TPoolPolicy>,
+        public Retry2<TPBuf, TAddr, TRetryImpl, TItem, TSchedulerPolicy>
 {
 public:
     typedef TItem item_type;
@@ -0,0 +1,184 @@
+/**
+ * @file
+ * Fixed capacity open addressing index over caller-owned items
+ *
+ * Items are neither copied nor owned - the index only refers to them, so it's up to the
+ * caller to remove an item before it goes away.  Since the key itself may not be stored
+ * in the item in any uniform way, callers supply the hash on insert and a match predicate
+ * on lookup.  Linear probing with backward shift deletion, so no tombstones build up
+ */
+#pragma once
+
+#include <estd/internal/platform.h>
+
+#include <stdint.h>
+
+namespace embr { namespace experimental {
+
+namespace internal {
+
+// murmur3 finalizer - spreads out sequential keys such as CoAP MIDs
+inline uint32_t hash_mix(uint32_t h)
+{
+    h ^= h >> 16;
+    h *= 0x85ebca6b;
+    h ^= h >> 13;
+    h *= 0xc2b2ae35;
+    h ^= h >> 16;
+
+    return h;
+}
+
+inline uint32_t hash_combine(uint32_t h, uint32_t value)
+{
+    return hash_mix(h ^ (value + 0x9e3779b9 + (h << 6) + (h >> 2)));
+}
+
+}
+
+// specialize for key types which don't convert to an integer
+template <class TKey>
+struct key_hash
+{
+    static uint32_t hash(const TKey& key)
+    {
+        return internal::hash_mix((uint32_t)key);
+    }
+};
+
+
+/// \tparam TItem type of item referred to
+/// \tparam slot_count must be a power of 2.  One slot is always kept empty so that
+/// unsuccessful lookups terminate, so at most slot_count - 1 items fit
+template <class TItem, size_t slot_count>
+class HashIndex
+{
+    static_assert((slot_count & (slot_count - 1)) == 0, "slot_count must be a power of 2");
+
+public:
+    typedef TItem item_type;
+    typedef item_type* pointer;
+
+private:
+    struct Slot
+    {
+        pointer item;
+        // cached, so that probing rarely has to look at items themselves
+        uint32_t hash;
+    };
+
+    Slot slots[slot_count];
+    size_t count;
+
+    static size_t home(uint32_t hash) { return hash & (slot_count - 1); }
+
+    static size_t next(size_t i) { return (i + 1) & (slot_count - 1); }
+
+    // locates slot referring to an item for which match(item) is true
+    // \return slot_count if not present
+    template <class F>
+    size_t find_slot(uint32_t hash, F match) const
+    {
+        for(size_t i = home(hash); slots[i].item != NULLPTR; i = next(i))
+        {
+            const Slot& slot = slots[i];
+
+            if(slot.hash == hash && match(slot.item)) return i;
+        }
+
+        return slot_count;
+    }
+
+    // shifts later members of probe run back into hole, so that their probes still find them
+    void erase_slot(size_t hole)
+    {
+        size_t i = hole;
+
+        for(;;)
+        {
+            i = next(i);
+
+            if(slots[i].item == NULLPTR) break;
+
+            size_t h = home(slots[i].hash);
+
+            // only move if hole lies (cyclically) between item's home and where it sits now
+            bool movable = hole <= i ?
+                (h <= hole || h > i) :
+                (h <= hole && h > i);
+
+            if(movable)
+            {
+                slots[hole] = slots[i];
+                hole = i;
+            }
+        }
+
+        slots[hole].item = NULLPTR;
+        --count;
+    }
+
+public:
+    HashIndex() : count(0)
+    {
+        for(size_t i = 0; i < slot_count; i++) slots[i].item = NULLPTR;
+    }
+
+    /// \return false, leaving item unindexed, if index is full
+    bool insert(pointer item, uint32_t hash)
+    {
+        if(count == slot_count - 1) return false;
+
+        size_t i = home(hash);
+
+        while(slots[i].item != NULLPTR) i = next(i);
+
+        slots[i].item = item;
+        slots[i].hash = hash;
+        ++count;
+
+        return true;
+    }
+
+    /// \return first indexed item with this hash for which match(item) is true, or null
+    template <class F>
+    pointer find(uint32_t hash, F match) const
+    {
+        size_t i = find_slot(hash, match);
+
+        return i == slot_count ? NULLPTR : slots[i].item;
+    }
+
+    /// like find, but also removes item from index
+    template <class F>
+    pointer remove(uint32_t hash, F match)
+    {
+        size_t i = find_slot(hash, match);
+
+        if(i == slot_count) return NULLPTR;
+
+        pointer item = slots[i].item;
+
+        erase_slot(i);
+
+        return item;
+    }
+
+    /// \param hash same as item was inserted with
+    /// \return false if item wasn't indexed
+    bool erase(pointer item, uint32_t hash)
+    {
+        return remove(hash, [item](pointer candidate) { return candidate == item; }) != NULLPTR;
+    }
+
+    size_t size() const { return count; }
+
+    static CONSTEXPR size_t capacity() { return slot_count - 1; }
+
+    // average probe length for a hit grows roughly as 1 / (1 - load_factor), so
+    // keeping this under ~0.7 keeps lookups short
+    float load_factor() const { return (float)count / slot_count; }
+};
+
+
+}}
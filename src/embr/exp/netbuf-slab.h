@@ -0,0 +1,234 @@
+/**
+ *  @file
+ *  Size-class slab allocator, primarily intended to back NetBufDynamic chunks
+ *
+ *  Freed blocks are kept on per-size-class free lists rather than returned to
+ *  the general heap, so once warmed up (see NetBufSlabPool::reserve) steady-state
+ *  expand/destruct cycles of a NetBufDynamic are O(1) and heap-free
+ */
+#pragma once
+
+#include "../netbuf-dynamic.h"
+
+namespace embr { namespace mem { namespace experimental {
+
+// describes the size classes a NetBufSlabPool manages.  Class 'i' holds blocks of
+// (smallest_size << i) bytes, so with defaults that's 128, 256, 512 and 1024
+template <size_t _smallest_size = 128, unsigned _class_count = 4>
+struct NetBufSlabDefaultPolicy
+{
+    static CONSTEXPR size_t smallest_size = _smallest_size;
+    static CONSTEXPR unsigned class_count = _class_count;
+};
+
+// NOTE: Free lists are static, so all allocators sharing a TPolicy share one pool.  This is
+// what lets NetBufDynamic default-construct its allocator.  Not thread safe - use a distinct
+// TPolicy per thread or guard externally
+template <class TPolicy = NetBufSlabDefaultPolicy<>,
+          class TUpstream = std::allocator<uint8_t> >
+class NetBufSlabPool
+{
+public:
+    typedef TPolicy policy_type;
+    typedef TUpstream upstream_type;
+    typedef std::allocator_traits<TUpstream> upstream_traits;
+    typedef size_t size_type;
+
+    static CONSTEXPR unsigned class_count = policy_type::class_count;
+
+private:
+    // overlays the first bytes of a free block
+    struct FreeNode
+    {
+        FreeNode* next;
+    };
+
+    static FreeNode* free_lists[class_count];
+    static size_type free_counts[class_count];
+
+    static upstream_type get_upstream() { return upstream_type(); }
+
+    static void* upstream_allocate(size_type n)
+    {
+        upstream_type a = get_upstream();
+
+        return upstream_traits::allocate(a, n);
+    }
+
+    static void upstream_deallocate(void* p, size_type n)
+    {
+        upstream_type a = get_upstream();
+
+        upstream_traits::deallocate(a, static_cast<uint8_t*>(p), n);
+    }
+
+public:
+    static CONSTEXPR size_type class_size(unsigned class_index)
+    {
+        return policy_type::smallest_size << class_index;
+    }
+
+    // find smallest size class which can hold n bytes.  Returns class_count if n is
+    // too large for any class.  Bounded by class_count, so effectively O(1)
+    static unsigned class_index(size_type n)
+    {
+        unsigned i = 0;
+        size_type sz = policy_type::smallest_size;
+
+        while(i < class_count && sz < n)
+        {
+            sz <<= 1;
+            ++i;
+        }
+
+        return i;
+    }
+
+    static void* allocate(size_type n)
+    {
+        unsigned i = class_index(n);
+
+        // oversized requests bypass the slabs entirely
+        if(i == class_count) return upstream_allocate(n);
+
+        FreeNode* node = free_lists[i];
+
+        if(node != NULLPTR)
+        {
+            free_lists[i] = node->next;
+            --free_counts[i];
+            return node;
+        }
+
+        // cold path - class is empty, so go to upstream for a full class-sized block.
+        // that block is what gets recycled from here on out
+        return upstream_allocate(class_size(i));
+    }
+
+    // n must match what was passed to allocate, or at least land in the same size class
+    static void deallocate(void* p, size_type n)
+    {
+        unsigned i = class_index(n);
+
+        if(i == class_count)
+        {
+            upstream_deallocate(p, n);
+            return;
+        }
+
+        FreeNode* node = static_cast<FreeNode*>(p);
+
+        node->next = free_lists[i];
+        free_lists[i] = node;
+        ++free_counts[i];
+    }
+
+    ///
+    /// \brief prepopulates a size class so that even first-time allocations avoid upstream
+    /// \return false if upstream ran out of memory partway through
+    ///
+    static bool reserve(unsigned class_index, size_type count)
+    {
+        while(count--)
+        {
+            void* p = upstream_allocate(class_size(class_index));
+
+            if(p == NULLPTR) return false;
+
+            deallocate(p, class_size(class_index));
+        }
+
+        return true;
+    }
+
+    // hands every cached block back to upstream
+    static void release()
+    {
+        for(unsigned i = 0; i < class_count; i++)
+        {
+            FreeNode* node = free_lists[i];
+
+            while(node != NULLPTR)
+            {
+                FreeNode* next = node->next;
+                upstream_deallocate(node, class_size(i));
+                node = next;
+            }
+
+            free_lists[i] = NULLPTR;
+            free_counts[i] = 0;
+        }
+    }
+
+    // diagnostic: number of blocks presently cached in specified size class
+    static size_type free_count(unsigned class_index) { return free_counts[class_index]; }
+};
+
+template <class TPolicy, class TUpstream>
+typename NetBufSlabPool<TPolicy, TUpstream>::FreeNode*
+    NetBufSlabPool<TPolicy, TUpstream>::free_lists[NetBufSlabPool<TPolicy, TUpstream>::class_count];
+
+template <class TPolicy, class TUpstream>
+typename NetBufSlabPool<TPolicy, TUpstream>::size_type
+    NetBufSlabPool<TPolicy, TUpstream>::free_counts[NetBufSlabPool<TPolicy, TUpstream>::class_count];
+
+
+// stateless std-style allocator fronting a NetBufSlabPool, suitable for NetBufDynamic's
+// TAllocator
+template <class T, class TPool = NetBufSlabPool<> >
+struct NetBufSlabAllocator
+{
+    typedef T value_type;
+    typedef T* pointer;
+    typedef const T* const_pointer;
+    typedef size_t size_type;
+    typedef TPool pool_type;
+
+    template <class U>
+    struct rebind
+    {
+        typedef NetBufSlabAllocator<U, TPool> other;
+    };
+
+    NetBufSlabAllocator() {}
+
+    template <class U>
+    NetBufSlabAllocator(const NetBufSlabAllocator<U, TPool>&) {}
+
+    pointer allocate(size_type n)
+    {
+        return static_cast<pointer>(pool_type::allocate(n * sizeof(T)));
+    }
+
+    void deallocate(pointer p, size_type n)
+    {
+        pool_type::deallocate(p, n * sizeof(T));
+    }
+
+    template <class U>
+    bool operator==(const NetBufSlabAllocator<U, TPool>&) const { return true; }
+
+    template <class U>
+    bool operator!=(const NetBufSlabAllocator<U, TPool>&) const { return false; }
+};
+
+
+// sizes minimum chunk allocation so that chunk header + data exactly fills the smallest
+// slab size class, rather than spilling into the next one up
+template <class TPool = NetBufSlabPool<> >
+struct NetBufDynamicSlabPolicy : NetBufDynamicDefaultPolicy
+{
+    CONSTEXPR int minimum_allocation_size() const
+    {
+        return (int)(TPool::class_size(0) - sizeof(NetBufDynamicChunk));
+    }
+
+    // relocating a trimmed chunk only pays off if it lands in a smaller size class
+    bool should_reclaim(int capacity, int size) const
+    {
+        return TPool::class_index(size + sizeof(NetBufDynamicChunk)) <
+               TPool::class_index(capacity + sizeof(NetBufDynamicChunk));
+    }
+};
+
+}}}
@@ -0,0 +1,426 @@
+/**
+ * @file
+ * Where Retry2 keeps items awaiting retransmission
+ *
+ * A scheduler policy supplies a nested Scheduler<TItem, TClock> offering:
+ *  - add(item) - item's due() must already be settled
+ *  - remove(item) - cancel, returning false if item wasn't present
+ *  - remove_first(match) - remove and return first item for which match(item) is true
+ *  - remove_match(received) - remove_first of item whose retry_match(received) is true
+ *  - dequeue_ready(now, ready) - remove and return an item whose time has come.  Called
+ *    repeatedly with the same 'now' to drain everything due
+ *  - next_deadline() - earliest due() present, or empty optional if no items
+ *  - empty()
+ */
+#pragma once
+
+#include <estd/chrono.h>
+#include <estd/forward_list.h>
+#include <estd/optional.h>
+
+#include "hash-index.h"
+
+namespace embr { namespace experimental {
+
+namespace internal {
+
+// removes and returns first item of 'list' for which match(item) is true, or null
+template <class TItem, class F>
+TItem* remove_first(estd::intrusive_forward_list<TItem>& list, F match)
+{
+    typedef typename estd::intrusive_forward_list<TItem>::iterator iterator;
+
+    iterator i = list.begin();
+    // no 'before begin', so track whether there's a preceding item at all
+    estd::optional<iterator> previous;
+
+    for(; i != list.end(); i++)
+    {
+        TItem& current = *i;
+
+        if(match(&current))
+        {
+            if(previous)
+                list.erase_after(*previous);
+            else
+                list.pop_front();
+
+            return &current;
+        }
+
+        previous = i;
+    }
+
+    return NULLPTR;
+}
+
+}
+
+
+/// Single list kept sorted by due().  Insert and cancel are O(n), getting the next
+/// ready item is O(1).  Fine for a handful of outstanding items
+struct RetryListPolicy
+{
+    template <class TItem, class TClock>
+    class Scheduler : public estd::intrusive_forward_list<TItem>
+    {
+        typedef estd::intrusive_forward_list<TItem> base_type;
+
+    public:
+        typedef TItem item_type;
+        typedef item_type* pointer;
+        typedef typename base_type::iterator iterator;
+        typedef typename TClock::time_point time_point;
+
+    private:
+        // All this 'before begin' compensation is a little annoying, but at least we aren't
+        // polluting iterators with that extra information 100% of the time.
+        void insert_after(estd::optional<iterator> preceding, pointer item)
+        {
+            if(preceding)
+                base_type::insert_after(*preceding, *item);
+            else
+                base_type::push_front(*item);
+        }
+
+    public:
+        // linear search to splice item into proper time slot
+        void add(pointer item)
+        {
+            iterator i = base_type::begin();
+            estd::optional<iterator> previous;
+
+            for(; i != base_type::end(); i++)
+            {
+                // insert just before first item due after this one, so that items due at
+                // the same time retain the order they were added in
+                if(item->less_than(*i))
+                {
+                    insert_after(previous, item);
+                    return;
+                }
+
+                previous = i;
+            }
+
+            // every present item is due no later than this one, or no items present at all
+            insert_after(previous, item);
+        }
+
+        template <class F>
+        pointer remove_first(F match)
+        {
+            return internal::remove_first(*this, match);
+        }
+
+        bool remove(pointer item)
+        {
+            return remove_first([item](pointer current) { return current == item; }) != NULLPTR;
+        }
+
+        pointer remove_match(pointer received)
+        {
+            return remove_first([received](pointer current) { return current->retry_match(received); });
+        }
+
+        // only front need be consulted, since list is sorted
+        template <class F>
+        pointer dequeue_ready(time_point, F ready)
+        {
+            if(base_type::empty()) return NULLPTR;
+
+            pointer item = &base_type::front();
+
+            if(!ready(item)) return NULLPTR;
+
+            base_type::pop_front();
+            return item;
+        }
+
+        estd::optional<time_point> next_deadline()
+        {
+            if(base_type::empty()) return estd::optional<time_point>();
+
+            return base_type::front().due();
+        }
+    };
+};
+
+
+/// Hashed timing wheel: slot_count buckets each tick_ms wide, an item landing in bucket
+/// (due / tick_ms) % slot_count.  Items due more than one revolution out share a bucket with
+/// nearer ones and are passed over until their time comes.  Insert, cancel and expiry are O(1)
+/// on average, so long as slot_count is comfortably more than items due per revolution
+/// \tparam slot_count number of buckets
+/// \tparam tick_ms width of each bucket.  Much finer than typical retry spacing buys nothing
+template <size_t slot_count = 64, unsigned tick_ms = 100>
+struct RetryWheelPolicy
+{
+    template <class TItem, class TClock>
+    class Scheduler
+    {
+    public:
+        typedef TItem item_type;
+        typedef item_type* pointer;
+        typedef typename TClock::time_point time_point;
+
+    private:
+        typedef estd::intrusive_forward_list<item_type> bucket_type;
+        typedef typename estd::chrono::milliseconds::rep tick_type;
+
+        bucket_type buckets[slot_count];
+        // earliest tick which may still hold a ready item.  dequeue_ready sweeps from here
+        tick_type cursor;
+        size_t count;
+
+        static tick_type to_tick(const time_point& t)
+        {
+            return estd::chrono::duration_cast<estd::chrono::milliseconds>(
+                t.time_since_epoch()).count() / tick_ms;
+        }
+
+        bucket_type& bucket(tick_type tick)
+        {
+            return buckets[(size_t)(tick % slot_count)];
+        }
+
+        bucket_type& bucket(pointer item)
+        {
+            return bucket(to_tick(item->due()));
+        }
+
+        // earliest due() amongst items in 'b' for which match(item) is true
+        template <class F>
+        static estd::optional<time_point> earliest(bucket_type& b, F match)
+        {
+            estd::optional<time_point> found;
+
+            for(item_type& item : b)
+            {
+                if(match(&item) && (!found || item.due() < *found))
+                    found = item.due();
+            }
+
+            return found;
+        }
+
+    public:
+        Scheduler() : cursor(0), count(0) {}
+
+        Scheduler(const Scheduler&) = delete;
+        Scheduler& operator=(const Scheduler&) = delete;
+
+        void add(pointer item)
+        {
+            tick_type tick = to_tick(item->due());
+
+            // already due items would otherwise wait for sweep to come all the way around.
+            // When empty, cursor may be stale, so start next_deadline's walk from here
+            if(count == 0 || tick < cursor) cursor = tick;
+
+            bucket(tick).push_front(*item);
+            ++count;
+        }
+
+        // one bucket's worth of search
+        bool remove(pointer item)
+        {
+            if(internal::remove_first(bucket(item),
+                [item](pointer current) { return current == item; }) == NULLPTR)
+                return false;
+
+            --count;
+            return true;
+        }
+
+        // NOTE: visits every bucket, so O(slot_count + n)
+        template <class F>
+        pointer remove_first(F match)
+        {
+            for(size_t i = 0; i < slot_count; i++)
+            {
+                pointer item = internal::remove_first(buckets[i], match);
+
+                if(item != NULLPTR)
+                {
+                    --count;
+                    return item;
+                }
+            }
+
+            return NULLPTR;
+        }
+
+        pointer remove_match(pointer received)
+        {
+            return remove_first([received](pointer current) { return current->retry_match(received); });
+        }
+
+        // sweeps buckets from cursor up to now, stopping at first ready item
+        template <class F>
+        pointer dequeue_ready(time_point now, F ready)
+        {
+            const tick_type now_tick = to_tick(now);
+
+            if(count == 0)
+            {
+                cursor = now_tick;
+                return NULLPTR;
+            }
+
+            // one revolution visits every bucket, so no need to go back further than that
+            if(now_tick - cursor >= (tick_type)slot_count)
+                cursor = now_tick - (tick_type)slot_count + 1;
+
+            for(;;)
+            {
+                pointer item = internal::remove_first(bucket(cursor), ready);
+
+                if(item != NULLPTR)
+                {
+                    --count;
+                    return item;
+                }
+
+                if(cursor >= now_tick) return NULLPTR;
+
+                ++cursor;
+            }
+        }
+
+        // Walks buckets in tick order from cursor, so usually stops well short of a full
+        // revolution.  Should overdue items linger, the time reported may not be the very
+        // earliest of them - but it will be one already passed
+        estd::optional<time_point> next_deadline()
+        {
+            if(count == 0) return estd::optional<time_point>();
+
+            const tick_type end = cursor + (tick_type)slot_count;
+
+            for(tick_type tick = cursor; tick < end; ++tick)
+            {
+                // passes over items belonging to later revolutions
+                estd::optional<time_point> found = earliest(bucket(tick),
+                    [tick](pointer item) { return to_tick(item->due()) <= tick; });
+
+                if(found) return found;
+            }
+
+            // everything is at least a revolution out, so look at all of it
+            estd::optional<time_point> found;
+
+            for(size_t i = 0; i < slot_count; i++)
+            {
+                estd::optional<time_point> candidate = earliest(buckets[i],
+                    [](pointer) { return true; });
+
+                if(candidate && (!found || *candidate < *found))
+                    found = candidate;
+            }
+
+            return found;
+        }
+
+        bool empty() const { return count == 0; }
+
+        size_t size() const { return count; }
+    };
+};
+
+
+/// Adds a hash index to another scheduler so that remove_match (ACK matching) need only
+/// look at items sharing received item's hash, rather than every outstanding item.
+/// Items must provide uint32_t retry_hash(), equal for a sent item and the received item
+/// which retry_matches it - typically combining key (i.e. CoAP MID) and endpoint.  Should the
+/// index fill up, further items are still scheduled but stay out of the index for as long
+/// as they're scheduled.  While any such remain, remove_match falls back to a full search
+/// \tparam TSchedulerPolicy underlying scheduler.  Its remove(item) ought to be cheap too,
+/// which RetryWheelPolicy's is and RetryListPolicy's isn't
+/// \tparam index_slots power of 2, sized so that load_factor() stays under ~0.7
+template <class TSchedulerPolicy = RetryWheelPolicy<>, size_t index_slots = 64>
+struct RetryIndexedPolicy
+{
+    template <class TItem, class TClock>
+    class Scheduler : public TSchedulerPolicy::template Scheduler<TItem, TClock>
+    {
+        typedef typename TSchedulerPolicy::template Scheduler<TItem, TClock> base_type;
+
+    public:
+        typedef TItem item_type;
+        typedef item_type* pointer;
+        typedef typename base_type::time_point time_point;
+
+    private:
+        HashIndex<item_type, index_slots> index;
+        // scheduled items which didn't fit in index
+        size_t unindexed;
+
+        void unindex(pointer item)
+        {
+            if(!index.erase(item, item->retry_hash())) --unindexed;
+        }
+
+    public:
+        Scheduler() : unindexed(0) {}
+
+        void add(pointer item)
+        {
+            base_type::add(item);
+
+            if(!index.insert(item, item->retry_hash())) ++unindexed;
+        }
+
+        bool remove(pointer item)
+        {
+            if(!base_type::remove(item)) return false;
+
+            unindex(item);
+            return true;
+        }
+
+        template <class F>
+        pointer remove_first(F match)
+        {
+            pointer item = base_type::remove_first(match);
+
+            if(item != NULLPTR) unindex(item);
+
+            return item;
+        }
+
+        pointer remove_match(pointer received)
+        {
+            pointer item = index.remove(received->retry_hash(),
+                [received](pointer current) { return current->retry_match(received); });
+
+            if(item != NULLPTR)
+                base_type::remove(item);
+            else if(unindexed > 0)
+            {
+                item = base_type::remove_match(received);
+
+                if(item != NULLPTR) --unindexed;
+            }
+
+            return item;
+        }
+
+        template <class F>
+        pointer dequeue_ready(time_point now, F ready)
+        {
+            pointer item = base_type::dequeue_ready(now, ready);
+
+            if(item != NULLPTR) unindex(item);
+
+            return item;
+        }
+
+        float load_factor() const { return index.load_factor(); }
+
+        // items which didn't fit into index, and so are only found by a full search
+        size_t index_overflow() const { return unindexed; }
+    };
+};
+
+
+}}
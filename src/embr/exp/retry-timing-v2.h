@@ -0,0 +1,164 @@
+/**
+ * @file
+ * Retransmission timing for BasicRetry, after RFC 7252 section 4.8 and RFC 6298
+ *
+ * A timing policy supplies the RFC 7252 transmission parameters as integers, so that
+ * no floating point is needed.  RttTable then refines ACK_TIMEOUT per endpoint from
+ * observed round trips
+ */
+#pragma once
+
+#include <estd/internal/platform.h>
+
+#include <stdint.h>
+
+namespace embr { namespace experimental {
+
+/// RFC 7252 defaults
+struct Rfc7252RetryTiming
+{
+    /// initial retransmission timeout for an endpoint we have no RTT samples for
+    static const uint32_t ack_timeout_ms = 2000;
+    /// ACK_RANDOM_FACTOR of 1.5, as a percentage
+    static const unsigned ack_random_factor_pct = 150;
+    static const unsigned max_retransmit = 4;
+
+    /// bounds on an estimated RTO.  RFC 6298 recommends no lower than 1s
+    static const uint32_t min_rto_ms = 1000;
+    static const uint32_t max_rto_ms = 60000;
+
+    /// number of endpoints RTT is tracked for.  Least recently sampled is forgotten first
+    static const size_t endpoint_slots = 8;
+};
+
+namespace internal {
+
+// tiny PRNG for jitter.  Not for anything needing unpredictability
+struct Xorshift32
+{
+    uint32_t state;
+
+    Xorshift32(uint32_t seed = 0x2545f491) : state(seed ? seed : 1) {}
+
+    uint32_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 17;
+        state ^= state << 5;
+
+        return state;
+    }
+};
+
+}
+
+/// Smoothed RTT and RTO per endpoint, per RFC 6298.  Kept in fixed point: SRTT in 1/8 ms and
+/// RTTVAR in 1/4 ms so that the 7/8 and 3/4 smoothing come down to shifts
+/// \tparam TAddr endpoint type, compared with ==
+/// \tparam TTiming see Rfc7252RetryTiming
+template <class TAddr, class TTiming = Rfc7252RetryTiming>
+class RttTable
+{
+public:
+    typedef TAddr addr_type;
+    typedef TTiming timing_type;
+
+private:
+    static const size_t slot_count = timing_type::endpoint_slots;
+
+    struct Entry
+    {
+        addr_type addr;
+        // scaled by 8
+        uint32_t srtt;
+        // scaled by 4
+        uint32_t rttvar;
+    };
+
+    // most recently sampled first, so eviction takes from the end
+    Entry entries[slot_count];
+    size_t count;
+
+    // \return slot_count if not present
+    size_t find(const addr_type& addr) const
+    {
+        for(size_t i = 0; i < count; i++)
+            if(entries[i].addr == addr) return i;
+
+        return slot_count;
+    }
+
+    // moves entry at 'i' to front, shifting those ahead of it back by one
+    void promote(size_t i)
+    {
+        Entry e = entries[i];
+
+        for(; i > 0; --i) entries[i] = entries[i - 1];
+
+        entries[0] = e;
+    }
+
+    static uint32_t rto(const Entry& e)
+    {
+        // SRTT + max(G, 4 * RTTVAR), with clock granularity G taken as 1ms.  rttvar is
+        // already 4 * RTTVAR by way of its scaling
+        uint32_t value = (e.srtt >> 3) + (e.rttvar > 1 ? e.rttvar : 1);
+
+        if(value < timing_type::min_rto_ms) return timing_type::min_rto_ms;
+        if(value > timing_type::max_rto_ms) return timing_type::max_rto_ms;
+
+        return value;
+    }
+
+public:
+    RttTable() : count(0) {}
+
+    /// \return retransmission timeout for addr, or ACK_TIMEOUT if it has no samples
+    uint32_t rto(const addr_type& addr) const
+    {
+        size_t i = find(addr);
+
+        return i == slot_count ? timing_type::ack_timeout_ms : rto(entries[i]);
+    }
+
+    /// @brief folds in a round trip measured to addr.  Caller is responsible for Karn's
+    /// algorithm, i.e. not sampling retransmitted messages
+    void sample(const addr_type& addr, uint32_t rtt_ms)
+    {
+        size_t i = find(addr);
+
+        if(i == slot_count)
+        {
+            // forget least recently sampled endpoint if full
+            if(count < slot_count) ++count;
+
+            i = count - 1;
+
+            Entry& e = entries[i];
+
+            e.addr = addr;
+            // first sample: SRTT = R, RTTVAR = R / 2
+            e.srtt = rtt_ms << 3;
+            e.rttvar = rtt_ms << 1;
+        }
+        else
+        {
+            Entry& e = entries[i];
+
+            int32_t delta = (int32_t)rtt_ms - (int32_t)(e.srtt >> 3);
+
+            // SRTT = 7/8 SRTT + 1/8 R
+            e.srtt += delta;
+            // RTTVAR = 3/4 RTTVAR + 1/4 |SRTT - R|
+            e.rttvar += (delta < 0 ? -delta : delta) - (int32_t)(e.rttvar >> 2);
+        }
+
+        promote(i);
+    }
+
+    /// number of endpoints with samples
+    size_t size() const { return count; }
+};
+
+
+}}
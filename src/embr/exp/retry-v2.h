@@ -4,6 +4,8 @@
 #pragma once
 
 #include "datapump-core-v2.h"
+#include "retry-scheduler-v2.h"
+#include "retry-timing-v2.h"
 
 namespace embr { namespace experimental {
 
@@ -12,12 +14,20 @@ struct retry_item_traits;
 
 // a reference implementation.  likely too generic to be of any use to anyone, but
 // indicates what to do for a more specific scenario
-template <class TPBuf, class TAddr, class TClock = estd::chrono::steady_clock>
+/// Retransmits with RFC 7252 style exponential backoff: first timeout is endpoint's RTO
+/// (ACK_TIMEOUT until we've measured it) scaled by a random factor in [1, ACK_RANDOM_FACTOR],
+/// doubling with each retransmission thereafter.  After MAX_RETRANSMIT retransmissions
+/// item waits out one last (doubled) timeout for an ACK before being given up on
+/// \tparam TTiming see Rfc7252RetryTiming
+template <class TPBuf, class TAddr, class TClock = estd::chrono::steady_clock,
+          class TTiming = Rfc7252RetryTiming>
 struct BasicRetry
 {
     typedef typename estd::remove_reference<TPBuf>::type pbuf_type;
     typedef TAddr addr_type;
     typedef TClock clock_type;
+    typedef typename clock_type::time_point time_point;
+    typedef TTiming timing_type;
     typedef embr::experimental::pbuf_traits<pbuf_type> pbuf_traits;
 
     // NOTE: playing some games explicitly stating this so that retry code doesn't
@@ -37,6 +47,9 @@ struct BasicRetry
 #endif
         typename TClock::time_point _due;
 
+        /// Current retransmission timeout, from last send to _due
+        uint32_t _timeout_ms = 0;
+
         /// Indicates number of retry/queue attempts made on this item so far
         TCounter _counter = 0;
 
@@ -47,13 +60,32 @@ struct BasicRetry
         // tracking integrate more easily
         typename TClock::time_point due() const { return _due; }
 
+        uint32_t timeout_ms() const { return _timeout_ms; }
+
+        /// when this item was last handed to transport, as of its most recent queued()
+        typename TClock::time_point sent() const
+        {
+            return _due - estd::chrono::milliseconds(_timeout_ms);
+        }
+
         /// @brief called when this item is actually added to retry list
-        void queued()
+        /// \param now time item was sent
+        /// \param timeout_ms how long after that to retry
+        void queued(typename TClock::time_point now, uint32_t timeout_ms)
         {
-            // TODO: this is where we'll assign due as well
+            _timeout_ms = timeout_ms;
+            _due = now + estd::chrono::milliseconds(timeout_ms);
             _counter++;
         }
 
+        /// @brief for RetryIndexedPolicy.  No message key is known at this level, so this
+        /// hashes endpoint alone.  Items which have one (i.e. CoAP MID) ought to hide this
+        /// with a hash combining key and endpoint
+        uint32_t retry_hash() const
+        {
+            return key_hash<TAddr>::hash(this->addr);
+        }
+
         // TODO: probably replace this with a specialized operator <
         bool less_than(const RetryItemBase& compare_to)
         {
@@ -80,28 +112,96 @@ struct BasicRetry
         }
     };
 
+    /// per endpoint RTT estimates, from which initial timeouts are drawn
+    RttTable<addr_type, timing_type> rtt;
+    internal::Xorshift32 random;
+
+    /// @brief reseed jitter.  Devices sharing a seed will retransmit in lockstep
+    void seed(uint32_t value) { random = internal::Xorshift32(value); }
+
+    /// @brief timeout for first transmission to addr: RTO times a random factor
+    /// between 1 and ACK_RANDOM_FACTOR
+    uint32_t initial_timeout(const addr_type& addr)
+    {
+        const unsigned spread = timing_type::ack_random_factor_pct - 100;
+        unsigned pct = 100 + (spread == 0 ? 0 : random.next() % (spread + 1));
+
+        return (uint32_t)((uint64_t)rtt.rto(addr) * pct / 100);
+    }
+
     /// @brief indicate that this item should be a part of retry list
     /// It's expected we've already filtered that this IS a CON/retry-wanting
     /// message by the time we get here
-    bool should_queue(RetryItem* item)
+    ///
+    /// Holds true through the last retransmission too, so that its ACK still has
+    /// something to match against
+    template <class TItem>
+    bool should_queue(TItem* item)
     {
-        return item->counter() < 3;
+        return item->counter() <= (int)timing_type::max_retransmit;
+    }
+
+    /// @brief whether an item which came due ought to go out again
+    ///
+    /// Same limit as should_queue, since an item is only ever sent when it's to be queued.
+    /// Policies overriding should_queue should override this also
+    /// \return false once MAX_RETRANSMIT retransmissions have been waited out
+    template <class TItem>
+    bool should_resend(TItem* item)
+    {
+        return should_queue(item);
+    }
+
+    /// @brief assigns item's due time just as it goes into retry list
+    ///
+    /// First transmission gets initial_timeout, each retransmission double the previous
+    template <class TItem>
+    void queued(TItem* item, time_point now)
+    {
+        uint32_t timeout = item->counter() == 0 ?
+            initial_timeout(item->addr) :
+            item->timeout_ms() * 2;
+
+        item->queued(now, timeout);
+    }
+
+    /// @brief called once item's ACK has removed it from retry list
+    ///
+    /// Per Karn's algorithm, only items never retransmitted yield an RTT sample,
+    /// since otherwise there's no telling which transmission the ACK answers
+    template <class TItem>
+    void acknowledged(TItem* item, time_point now)
+    {
+        if(item->counter() != 1) return;
+
+        rtt.sample(item->addr, (uint32_t)estd::chrono::duration_cast<estd::chrono::milliseconds>(
+            now - item->sent()).count());
     }
 
     /// @brief Indicate whether the specified retry item is ready for an actual resend
     /// Generally meaning has item's due date passed
     /// \param item
     /// \return
-    bool ready_for_send(RetryItem* item)
+    template <class TItem>
+    bool ready_for_send(TItem* item)
     {
-        return clock_type::now() >= item->due();
+        return ready_for_send(item, clock_type::now());
+    }
+
+    /// @brief as above, but against a 'now' already obtained by caller
+    template <class TItem>
+    bool ready_for_send(TItem* item, typename clock_type::time_point now)
+    {
+        return now >= item->due();
     }
 };
 
+/// \tparam TSchedulerPolicy how retry list is organized - see retry-scheduler-v2.h
 template <
         class TPBuf, class TAddr,
         class TRetryImpl = BasicRetry<TPBuf, TAddr>,
-        class TItem = typename TRetryImpl::RetryItem >
+        class TItem = typename TRetryImpl::RetryItem,
+        class TSchedulerPolicy = RetryListPolicy>
 class Retry2
 {
     TRetryImpl retry_impl;
@@ -111,37 +211,19 @@ public:
     //typedef typename retry_impl_type::RetryItem retry_item;
     typedef TItem item_type;
     typedef item_type* pointer;
+    typedef typename retry_impl_type::clock_type clock_type;
+    typedef typename clock_type::time_point time_point;
+    typedef estd::intrusive_forward_list_with_back<item_type> ready_list_type;
+
+    retry_impl_type& impl() { return retry_impl; }
 
 #ifdef UNIT_TESTING
 public:
 #else
     protected:
 #endif
-    typedef estd::intrusive_forward_list<item_type> list_type;
+    typedef typename TSchedulerPolicy::template Scheduler<item_type, clock_type> list_type;
     list_type retry_list;
-    typedef typename list_type::iterator iterator;
-
-    // TODO: will very likely want preceding item also to do a more efficient delete
-    // internal call, removes the item *after* the specified preceding_item from retry list
-    void _remove_from_retry(estd::optional<iterator> preceding_item)
-    {
-        if(preceding_item)
-            retry_list.erase_after(*preceding_item);
-        else
-            // if there is no preceding item, it is assumed we're pulling off the front item
-            // another artifact of having no 'before begin'
-            retry_list.pop_front();
-    }
-
-    // All this 'before begin' compensation is a little annoying, but at least we aren't
-    // polluting iterators with that extra information 100% of the time.
-    void _add_to_retry(estd::optional<iterator> preceding, pointer item)
-    {
-        if(preceding)
-            retry_list.insert_after(*preceding, *item);
-        else
-            retry_list.push_front(*item);
-    }
 
 public:
     ///
@@ -155,8 +237,9 @@ public:
     {
         if(retry_impl.should_queue(sent_item))
         {
+            // item settles its due time here, which add_to_retry needs to place it
+            retry_impl.queued(sent_item, clock_type::now());
             add_to_retry(sent_item);
-            sent_item->queued();
             return true;
         }
         else
@@ -174,33 +257,16 @@ public:
     pointer evaluate_remove_from_retry(pointer received_item)
     {
         //if(retry_impl.should_dequeue(received_item, received_item->pbuf))
-        {
-            // scour through retry list looking for *associated with* received_item
-            // and remove that associated item - returning it here
-            typename list_type::iterator i = retry_list.begin();
-            // TODO: Not optimal/optimized, but convenient
-            typename estd::optional<typename list_type::iterator> previous;
-
-            for(;i != retry_list.end(); i++)
-            {
-                item_type& current = *i;
-
-                // evaluate if received_item ACK matches up to retry_list CON
-                if(current.retry_match(received_item))
-                {
-                    // if so, remove the retry-tracked item from
-                    // our retry list, then return the Item* so that
-                    // others may operate on it (i.e. explicitly free it)
-                    _remove_from_retry(previous);
-
-                    return &current;
-                }
-
-                previous = i;
-            }
-
-            return NULLPTR;
-        }
+        // scour through retry list looking for *associated with* received_item
+        // and remove that associated item - returning it here so that others
+        // may operate on it (i.e. explicitly free it)
+        // evaluate if received_item ACK matches up to retry_list CON
+        pointer removed = retry_list.remove_match(received_item);
+
+        if(removed != NULLPTR)
+            retry_impl.acknowledged(removed, clock_type::now());
+
+        return removed;
     }
 
     /// @brief if the time is right, retrieve an Item* to send over transport as a retry
@@ -210,45 +276,63 @@ public:
     /// \return Item* or NULLPTR if nothing yet is ready
     pointer dequeue_retry_ready()
     {
-        pointer item = &retry_list.front();
-        if(item && retry_impl.ready_for_send(item))
+        return dequeue_retry_ready(clock_type::now());
+    }
+
+    /// @brief whether item, just dequeued as ready, is to be resent.  If not, retries
+    /// are exhausted and caller is to give up on it
+    bool should_resend(pointer item)
+    {
+        return retry_impl.should_resend(item);
+    }
+
+    /// @brief as above, but against a 'now' already obtained by caller
+    pointer dequeue_retry_ready(time_point now)
+    {
+        return retry_list.dequeue_ready(now, [this, now](pointer item)
         {
-            retry_list.pop_front();
-            return item;
-        }
-        else
-            return NULLPTR;
+            return retry_impl.ready_for_send(item, now);
+        });
     }
 
-    /// @brief adds to retry list
+    /// @brief removes every item due as of 'now' in one sweep, appending them to 'ready'
     ///
-    /// including a linear search to splice it into proper time slot
-    void add_to_retry(pointer sent_item)
+    /// Items come out in the order the scheduler gives them up - due order for RetryListPolicy
+    ///
+    /// \return number of items appended
+    size_t dequeue_retry_ready(time_point now, ready_list_type& ready)
     {
-        // TODO: likely want to embed this into retry_impl
-        // TODO: need to do requisite sort placement also
-        typename list_type::iterator i = retry_list.begin();
-        estd::optional<iterator> previous;
-
+        size_t count = 0;
+        pointer item;
 
-        for(;i != retry_list.end(); i++)
+        while((item = dequeue_retry_ready(now)) != NULLPTR)
         {
-            item_type& current = *i;
+            ready.push_back(*item);
+            ++count;
+        }
+
+        return count;
+    }
 
-            // Look to insert sent_item in time slot just before item to be sent after it
-            // or in other words, insert just before first encounter of current.due >= sent_item.due,
-            if(!sent_item->less_than(current))
-            {
-                _add_to_retry(previous, sent_item);
-                return;
-            }
+    /// @brief when the earliest outstanding retry comes due, so that a service loop
+    /// may sleep until then rather than poll
+    /// \return empty if retry list is empty.  May be in the past
+    estd::optional<time_point> next_deadline()
+    {
+        return retry_list.next_deadline();
+    }
 
-            previous = i;
-        }
+    /// @brief adds to retry list, placed according to its due time
+    void add_to_retry(pointer sent_item)
+    {
+        retry_list.add(sent_item);
+    }
 
-        // If loop completed, that means every present item.due was < sent_item.due
-        // OR no items present at all.  In either case, we want to 'add to the end'
-        _add_to_retry(previous, sent_item);
+    /// @brief gives up on retrying item, without waiting for an ACK or for it to come due
+    /// \return false if item wasn't in retry list
+    bool remove_from_retry(pointer item)
+    {
+        return retry_list.remove(item);
     }
 };
 
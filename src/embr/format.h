@@ -0,0 +1,536 @@
+/**
+ *  @file
+ *  printf-free decimal formatting of integers and floating point, plus helpers
+ *  to write the result directly into a NetBufWriter or out_netbuf_streambuf
+ *
+ *  Integers are generated two digits at a time from a lookup table.  Floating
+ *  point uses Grisu2 (Loitsch, "Printing Floating-Point Numbers Quickly and
+ *  Accurately with Integers") which always produces digits that read back to
+ *  the identical value, and nearly always the shortest such digits
+ */
+#pragma once
+
+#include <estd/internal/platform.h>
+
+#include <stdint.h>
+#include <string.h>
+
+namespace embr {
+
+namespace mem {
+
+template <class TNetBuf, class TPolicy>
+class NetBufWriter;
+
+}
+
+namespace internal {
+
+// longest rendering of any value to_decimal accepts, i.e. "-2.2250738585072014e-308"
+// with a little headroom
+static const unsigned max_decimal_chars = 32;
+
+inline const char* decimal_digit_pairs()
+{
+    static const char lut[201] =
+        "0001020304050607080910111213141516171819"
+        "2021222324252627282930313233343536373839"
+        "4041424344454647484950515253545556575859"
+        "6061626364656667686970717273747576777879"
+        "8081828384858687888990919293949596979899";
+
+    return lut;
+}
+
+template <class TUInt>
+inline unsigned decimal_digit_count(TUInt v)
+{
+    unsigned n = 1;
+
+    for(;;)
+    {
+        if(v < 10) return n;
+        if(v < 100) return n + 1;
+        if(v < 1000) return n + 2;
+        if(v < 10000) return n + 3;
+        v /= 10000;
+        n += 4;
+    }
+}
+
+// writes digits of v starting at out, no null termination
+// \return one past last character written
+template <class TUInt>
+char* format_unsigned(char* out, TUInt v)
+{
+    const char* lut = decimal_digit_pairs();
+    char* end = out + decimal_digit_count(v);
+    char* p = end;
+
+    while(v >= 100)
+    {
+        unsigned i = (unsigned)(v % 100) * 2;
+        v /= 100;
+        p -= 2;
+        p[0] = lut[i];
+        p[1] = lut[i + 1];
+    }
+
+    if(v >= 10)
+    {
+        unsigned i = (unsigned)v * 2;
+        out[0] = lut[i];
+        out[1] = lut[i + 1];
+    }
+    else
+        out[0] = (char)('0' + v);
+
+    return end;
+}
+
+template <class TUInt, class TInt>
+char* format_signed(char* out, TInt v)
+{
+    if(v < 0)
+    {
+        *out++ = '-';
+        // unsigned negation so that most negative value doesn't overflow
+        return format_unsigned(out, (TUInt)(TUInt(0) - (TUInt)v));
+    }
+
+    return format_unsigned(out, (TUInt)v);
+}
+
+// bases 2 - 36, lower case letters
+template <class TUInt>
+char* format_unsigned(char* out, TUInt v, unsigned base)
+{
+    char* p = out;
+
+    do
+    {
+        unsigned d = (unsigned)(v % base);
+        *p++ = (char)(d < 10 ? '0' + d : 'a' + d - 10);
+        v /= base;
+    }
+    while(v);
+
+    for(char* l = out, *r = p - 1; l < r; l++, r--)
+    {
+        char c = *l;
+        *l = *r;
+        *r = c;
+    }
+
+    return p;
+}
+
+namespace grisu {
+
+// "do it yourself floating point", f * 2^e
+struct diy_fp
+{
+    uint64_t f;
+    int e;
+
+    diy_fp(uint64_t f, int e) : f(f), e(e) {}
+
+    diy_fp operator-(const diy_fp& rhs) const { return diy_fp(f - rhs.f, e); }
+
+    // upper 64 bits of 128 bit product, rounded
+    diy_fp operator*(const diy_fp& rhs) const
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 p = (unsigned __int128)f * rhs.f;
+        uint64_t h = (uint64_t)(p >> 64);
+        uint64_t l = (uint64_t)p;
+        return diy_fp(h + (l >> 63), e + rhs.e + 64);
+#else
+        const uint64_t m32 = 0xFFFFFFFF;
+        uint64_t a = f >> 32, b = f & m32;
+        uint64_t c = rhs.f >> 32, d = rhs.f & m32;
+        uint64_t ac = a * c, bc = b * c, ad = a * d, bd = b * d;
+        uint64_t tmp = (bd >> 32) + (ad & m32) + (bc & m32);
+        tmp += 1U << 31;
+        return diy_fp(ac + (ad >> 32) + (bc >> 32) + (tmp >> 32), e + rhs.e + 64);
+#endif
+    }
+
+    diy_fp normalize() const
+    {
+        diy_fp r = *this;
+        while(!(r.f & ((uint64_t)1 << 63)))
+        {
+            r.f <<= 1;
+            r.e--;
+        }
+        return r;
+    }
+};
+
+template <class TFloat>
+struct float_layout;
+
+template <>
+struct float_layout<double>
+{
+    typedef uint64_t bits_type;
+    static const int significand_bits = 52;
+    static const int exponent_bits = 11;
+    // includes shift of significand to an integer
+    static const int exponent_bias = 1023 + 52;
+};
+
+template <>
+struct float_layout<float>
+{
+    typedef uint32_t bits_type;
+    static const int significand_bits = 23;
+    static const int exponent_bits = 8;
+    static const int exponent_bias = 127 + 23;
+};
+
+// cached powers 10^-348, 10^-340 ... 10^340 as normalized diy_fp
+inline diy_fp cached_power_by_index(unsigned index)
+{
+    static const uint64_t f[] =
+    {
+        0xFA8FD5A0081C0288, 0xBAAEE17FA23EBF76, 0x8B16FB203055AC76, 0xCF42894A5DCE35EA,
+        0x9A6BB0AA55653B2D, 0xE61ACF033D1A45DF, 0xAB70FE17C79AC6CA, 0xFF77B1FCBEBCDC4F,
+        0xBE5691EF416BD60C, 0x8DD01FAD907FFC3C, 0xD3515C2831559A83, 0x9D71AC8FADA6C9B5,
+        0xEA9C227723EE8BCB, 0xAECC49914078536D, 0x823C12795DB6CE57, 0xC21094364DFB5637,
+        0x9096EA6F3848984F, 0xD77485CB25823AC7, 0xA086CFCD97BF97F4, 0xEF340A98172AACE5,
+        0xB23867FB2A35B28E, 0x84C8D4DFD2C63F3B, 0xC5DD44271AD3CDBA, 0x936B9FCEBB25C996,
+        0xDBAC6C247D62A584, 0xA3AB66580D5FDAF6, 0xF3E2F893DEC3F126, 0xB5B5ADA8AAFF80B8,
+        0x87625F056C7C4A8B, 0xC9BCFF6034C13053, 0x964E858C91BA2655, 0xDFF9772470297EBD,
+        0xA6DFBD9FB8E5B88F, 0xF8A95FCF88747D94, 0xB94470938FA89BCF, 0x8A08F0F8BF0F156B,
+        0xCDB02555653131B6, 0x993FE2C6D07B7FAC, 0xE45C10C42A2B3B06, 0xAA242499697392D3,
+        0xFD87B5F28300CA0E, 0xBCE5086492111AEB, 0x8CBCCC096F5088CC, 0xD1B71758E219652C,
+        0x9C40000000000000, 0xE8D4A51000000000, 0xAD78EBC5AC620000, 0x813F3978F8940984,
+        0xC097CE7BC90715B3, 0x8F7E32CE7BEA5C70, 0xD5D238A4ABE98068, 0x9F4F2726179A2245,
+        0xED63A231D4C4FB27, 0xB0DE65388CC8ADA8, 0x83C7088E1AAB65DB, 0xC45D1DF942711D9A,
+        0x924D692CA61BE758, 0xDA01EE641A708DEA, 0xA26DA3999AEF774A, 0xF209787BB47D6B85,
+        0xB454E4A179DD1877, 0x865B86925B9BC5C2, 0xC83553C5C8965D3D, 0x952AB45CFA97A0B3,
+        0xDE469FBD99A05FE3, 0xA59BC234DB398C25, 0xF6C69A72A3989F5C, 0xB7DCBF5354E9BECE,
+        0x88FCF317F22241E2, 0xCC20CE9BD35C78A5, 0x98165AF37B2153DF, 0xE2A0B5DC971F303A,
+        0xA8D9D1535CE3B396, 0xFB9B7CD9A4A7443C, 0xBB764C4CA7A44410, 0x8BAB8EEFB6409C1A,
+        0xD01FEF10A657842C, 0x9B10A4E5E9913129, 0xE7109BFBA19C0C9D, 0xAC2820D9623BF429,
+        0x80444B5E7AA7CF85, 0xBF21E44003ACDD2D, 0x8E679C2F5E44FF8F, 0xD433179D9C8CB841,
+        0x9E19DB92B4E31BA9, 0xEB96BF6EBADF77D9, 0xAF87023B9BF0EE6B,
+    };
+    static const int16_t e[] =
+    {
+        -1220, -1193, -1166, -1140, -1113, -1087, -1060, -1034, -1007,  -980,
+         -954,  -927,  -901,  -874,  -847,  -821,  -794,  -768,  -741,  -715,
+         -688,  -661,  -635,  -608,  -582,  -555,  -529,  -502,  -475,  -449,
+         -422,  -396,  -369,  -343,  -316,  -289,  -263,  -236,  -210,  -183,
+         -157,  -130,  -103,   -77,   -50,   -24,     3,    30,    56,    83,
+          109,   136,   162,   189,   216,   242,   269,   295,   322,   348,
+          375,   402,   428,   455,   481,   508,   534,   561,   588,   614,
+          641,   667,   694,   720,   747,   774,   800,   827,   853,   880,
+          907,   933,   960,   986,  1013,  1039,  1066,
+    };
+
+    return diy_fp(f[index], e[index]);
+}
+
+// picks cached power c_k so that binary exponent of (2^e * c_k) lands within [-60, -32]
+// \param k receives -k of the chosen decimal power
+inline diy_fp cached_power(int e, int* k)
+{
+    double dk = (-61 - e) * 0.30102999566398114 + 347;
+    int ik = (int)dk;
+
+    if(dk - ik > 0.0) ik++;
+
+    unsigned index = (unsigned)((ik >> 3) + 1);
+
+    *k = -(-348 + (int)(index << 3));
+
+    return cached_power_by_index(index);
+}
+
+inline uint64_t power_of_10(unsigned i)
+{
+    static const uint64_t p[] =
+    {
+        1ULL, 10ULL, 100ULL, 1000ULL, 10000ULL, 100000ULL, 1000000ULL, 10000000ULL,
+        100000000ULL, 1000000000ULL, 10000000000ULL, 100000000000ULL, 1000000000000ULL,
+        10000000000000ULL, 100000000000000ULL, 1000000000000000ULL,
+        10000000000000000ULL, 100000000000000000ULL, 1000000000000000000ULL,
+        10000000000000000000ULL
+    };
+
+    return p[i];
+}
+
+// nudges last digit down while that brings it closer to w, staying within range
+inline void round_weed(char* buffer, int len, uint64_t delta, uint64_t rest,
+    uint64_t ten_kappa, uint64_t wp_w)
+{
+    while(rest < wp_w && delta - rest >= ten_kappa &&
+        (rest + ten_kappa < wp_w || wp_w - rest > rest + ten_kappa - wp_w))
+    {
+        buffer[len - 1]--;
+        rest += ten_kappa;
+    }
+}
+
+// generates shortest digits of Mp which stay within delta of it
+inline void digit_gen(const diy_fp& w, const diy_fp& mp, uint64_t delta,
+    char* buffer, int* len, int* k)
+{
+    const diy_fp one((uint64_t)1 << -mp.e, mp.e);
+    const diy_fp wp_w = mp - w;
+    uint32_t p1 = (uint32_t)(mp.f >> -one.e);
+    uint64_t p2 = mp.f & (one.f - 1);
+    int kappa = (int)decimal_digit_count(p1);
+
+    *len = 0;
+
+    while(kappa > 0)
+    {
+        uint32_t divisor = (uint32_t)power_of_10(kappa - 1);
+        uint32_t d = p1 / divisor;
+
+        p1 %= divisor;
+
+        if(d || *len) buffer[(*len)++] = (char)('0' + d);
+
+        kappa--;
+
+        uint64_t tmp = ((uint64_t)p1 << -one.e) + p2;
+
+        if(tmp <= delta)
+        {
+            *k += kappa;
+            round_weed(buffer, *len, delta, tmp, power_of_10(kappa) << -one.e, wp_w.f);
+            return;
+        }
+    }
+
+    for(;;)
+    {
+        p2 *= 10;
+        delta *= 10;
+
+        char d = (char)(p2 >> -one.e);
+
+        if(d || *len) buffer[(*len)++] = (char)('0' + d);
+
+        p2 &= one.f - 1;
+        kappa--;
+
+        if(p2 < delta)
+        {
+            *k += kappa;
+            int index = -kappa;
+            round_weed(buffer, *len, delta, p2, one.f,
+                wp_w.f * (index < 20 ? power_of_10(index) : 0));
+            return;
+        }
+    }
+}
+
+// value must be finite and positive.  Digits land in buffer, value ~= digits * 10^k
+template <class TFloat>
+void grisu2(TFloat value, char* buffer, int* len, int* k)
+{
+    typedef float_layout<TFloat> layout;
+    typedef typename layout::bits_type bits_type;
+
+    const bits_type hidden = (bits_type)1 << layout::significand_bits;
+    bits_type bits;
+
+    memcpy(&bits, &value, sizeof(bits));
+
+    int biased_e = (int)(bits >> layout::significand_bits) &
+        ((1 << layout::exponent_bits) - 1);
+    bits_type significand = bits & (hidden - 1);
+
+    diy_fp v(significand, 1 - layout::exponent_bias);
+
+    if(biased_e != 0)
+    {
+        v.f += hidden;
+        v.e = biased_e - layout::exponent_bias;
+    }
+
+    // boundaries m-, m+ halfway to neighboring representable values.  Lower
+    // neighbor is closer when significand is an exact power of 2
+    diy_fp plus = diy_fp((v.f << 1) + 1, v.e - 1).normalize();
+    diy_fp minus = (v.f == hidden && biased_e > 1) ?
+        diy_fp((v.f << 2) - 1, v.e - 2) :
+        diy_fp((v.f << 1) - 1, v.e - 1);
+
+    minus.f <<= minus.e - plus.e;
+    minus.e = plus.e;
+
+    const diy_fp c_mk = cached_power(plus.e, k);
+    const diy_fp w = v.normalize() * c_mk;
+    diy_fp wp = plus * c_mk;
+    diy_fp wm = minus * c_mk;
+
+    // stay conservatively within boundaries, given imprecision of cached power
+    wm.f++;
+    wp.f--;
+
+    digit_gen(w, wp, wp.f - wm.f, buffer, len, k);
+}
+
+inline char* write_exponent(char* out, int k)
+{
+    if(k < 0)
+    {
+        *out++ = '-';
+        k = -k;
+    }
+
+    return format_unsigned(out, (unsigned)k);
+}
+
+// lays out 'len' digits (already at buffer) * 10^k in fixed or scientific notation,
+// in the manner of JavaScript's Number.toString
+inline char* prettify(char* buffer, int len, int k)
+{
+    // 10^(kk-1) <= v < 10^kk
+    const int kk = len + k;
+
+    if(0 <= k && kk <= 21)
+    {
+        // 1234e7 -> 12340000000
+        for(int i = len; i < kk; i++) buffer[i] = '0';
+        return buffer + kk;
+    }
+    else if(0 < kk && kk <= 21)
+    {
+        // 1234e-2 -> 12.34
+        memmove(buffer + kk + 1, buffer + kk, len - kk);
+        buffer[kk] = '.';
+        return buffer + len + 1;
+    }
+    else if(-6 < kk && kk <= 0)
+    {
+        // 1234e-6 -> 0.001234
+        const int offset = 2 - kk;
+        memmove(buffer + offset, buffer, len);
+        buffer[0] = '0';
+        buffer[1] = '.';
+        for(int i = 2; i < offset; i++) buffer[i] = '0';
+        return buffer + len + offset;
+    }
+    else if(len == 1)
+    {
+        // 1e30
+        buffer[1] = 'e';
+        return write_exponent(buffer + 2, kk - 1);
+    }
+    else
+    {
+        // 1234e30 -> 1.234e33
+        memmove(buffer + 2, buffer + 1, len - 1);
+        buffer[1] = '.';
+        buffer[len + 1] = 'e';
+        return write_exponent(buffer + len + 2, kk - 1);
+    }
+}
+
+}
+
+// shortest digits which read back (strtod) as exactly value
+template <class TFloat>
+char* format_float(char* out, TFloat value)
+{
+    if(value != value)
+    {
+        memcpy(out, "nan", 3);
+        return out + 3;
+    }
+
+    // sign bit rather than < 0 so that -0 comes out as such
+    typename grisu::float_layout<TFloat>::bits_type bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    if(bits >> (sizeof(bits) * 8 - 1))
+    {
+        *out++ = '-';
+        value = -value;
+    }
+
+    if(value == 0)
+    {
+        *out = '0';
+        return out + 1;
+    }
+
+    if(value - value != 0)
+    {
+        memcpy(out, "inf", 3);
+        return out + 3;
+    }
+
+    int len, k;
+
+    grisu::grisu2(value, out, &len, &k);
+
+    return grisu::prettify(out, len, k);
+}
+
+// out must have room for max_decimal_chars
+// \return one past last character written
+inline char* to_decimal(char* out, int v) { return format_signed<unsigned>(out, v); }
+inline char* to_decimal(char* out, long v) { return format_signed<unsigned long>(out, v); }
+inline char* to_decimal(char* out, long long v) { return format_signed<unsigned long long>(out, v); }
+inline char* to_decimal(char* out, unsigned v) { return format_unsigned(out, v); }
+inline char* to_decimal(char* out, unsigned long v) { return format_unsigned(out, v); }
+inline char* to_decimal(char* out, unsigned long long v) { return format_unsigned(out, v); }
+inline char* to_decimal(char* out, float v) { return format_float(out, v); }
+inline char* to_decimal(char* out, double v) { return format_float(out, v); }
+
+// fallback when digits couldn't be generated in place: copies them in, spilling
+// onto further chunks as needed
+template <class TNetBuf, class TPolicy>
+bool put_chars(mem::NetBufWriter<TNetBuf, TPolicy>& out, const char* s, size_t n)
+{
+    return (size_t)out.write(s, n) == n;
+}
+
+// out_netbuf_streambuf and friends
+template <class TStreambuf>
+bool put_chars(TStreambuf& out, const char* s, size_t n)
+{
+    return (size_t)out.sputn(s, n) == n;
+}
+
+}
+
+namespace experimental {
+
+///
+/// \brief writes decimal representation of value to a NetBufWriter or out_netbuf_streambuf
+///
+/// When current chunk has room for the longest possible representation, digits are
+/// generated directly into it.  Otherwise they are generated on the stack and copied in,
+/// crossing onto new chunks (or expanding) as needed
+///
+/// \return false if netbuf couldn't hold all of the digits
+///
+template <class TOut, class TValue>
+bool write_decimal(TOut& out, TValue value)
+{
+    char* p = reinterpret_cast<char*>(out.reserve(internal::max_decimal_chars).data());
+
+    if(p != NULLPTR)
+    {
+        out.commit(internal::to_decimal(p, value) - p);
+        return true;
+    }
+
+    char buf[internal::max_decimal_chars];
+
+    return internal::put_chars(out, buf, internal::to_decimal(buf, value) - buf);
+}
+
+}
+
+}
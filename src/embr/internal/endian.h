@@ -0,0 +1,93 @@
+/**
+ *  @file
+ *  Byte order helpers.  Loads and stores go through memcpy, which compilers
+ *  reduce to a single (unaligned-safe) load or store instruction
+ */
+#pragma once
+
+#include <estd/internal/platform.h>
+
+#include <stdint.h>
+#include <string.h>
+
+#if defined(__BYTE_ORDER__) && defined(__ORDER_BIG_ENDIAN__)
+#if __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+#define FEATURE_EMBR_BIG_ENDIAN
+#endif
+#endif
+
+namespace embr { namespace internal {
+
+inline CONSTEXPR bool is_little_endian()
+{
+#ifdef FEATURE_EMBR_BIG_ENDIAN
+    return false;
+#else
+    return true;
+#endif
+}
+
+inline uint16_t byteswap(uint16_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_bswap16(v);
+#else
+    return (uint16_t)((v << 8) | (v >> 8));
+#endif
+}
+
+inline uint32_t byteswap(uint32_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_bswap32(v);
+#else
+    return ((v & 0xFF) << 24) | ((v & 0xFF00) << 8) |
+        ((v >> 8) & 0xFF00) | (v >> 24);
+#endif
+}
+
+inline uint64_t byteswap(uint64_t v)
+{
+#if defined(__GNUC__)
+    return __builtin_bswap64(v);
+#else
+    return ((uint64_t)byteswap((uint32_t)v) << 32) | byteswap((uint32_t)(v >> 32));
+#endif
+}
+
+// native <-> network (big endian) byte order
+template <class TUInt>
+inline TUInt to_big_endian(TUInt v)
+{
+    return is_little_endian() ? byteswap(v) : v;
+}
+
+template <class TUInt>
+inline TUInt load_native(const void* p)
+{
+    TUInt v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+template <class TUInt>
+inline void store_native(void* p, TUInt v)
+{
+    memcpy(p, &v, sizeof(v));
+}
+
+// reads network order unsigned integer from possibly unaligned p
+template <class TUInt>
+inline TUInt load_big_endian(const void* p)
+{
+    return to_big_endian(load_native<TUInt>(p));
+}
+
+// writes network order unsigned integer to possibly unaligned p
+template <class TUInt>
+inline void store_big_endian(void* p, TUInt v)
+{
+    store_native(p, to_big_endian(v));
+}
+
+}}
@@ -6,27 +6,81 @@
 #include "netbuf.h"
 
 #include <estd/forward_list.h>
+#include <estd/algorithm.h>
 
 namespace embr { namespace mem {
 
 namespace experimental {
 
-struct NetBufDynamicDefaultPolicy
+// TGrowth decides how large each newly expanded chunk is.  See netbuf.h
+template <class TGrowth = ExactGrowthPolicy>
+struct NetBufDynamicPolicy : TGrowth
 {
     // represents minimum size to allocate
     CONSTEXPR int minimum_allocation_size() const { return 128; }
+
+    // during a shrink, whether a trimmed chunk is worth relocating into a right-sized
+    // allocation (a copy of 'size' bytes) so that the surplus goes back to the allocator
+    CONSTEXPR bool should_reclaim(int capacity, int size) const
+    {
+        return capacity - size >= 64;
+    }
 };
 
+typedef NetBufDynamicPolicy<> NetBufDynamicDefaultPolicy;
+
+}
+
+namespace internal {
+
+// Policies need only provide minimum_allocation_size.  Anything else NetBufDynamicPolicy
+// offers is looked for, and when absent the default policy's behavior stands in
+
+template <class TPolicy>
+inline auto should_reclaim(const TPolicy& policy, int capacity, int size, int)
+    -> decltype(policy.should_reclaim(capacity, size))
+{
+    return policy.should_reclaim(capacity, size);
+}
+
+template <class TPolicy>
+inline bool should_reclaim(const TPolicy&, int capacity, int size, long)
+{
+    return experimental::NetBufDynamicDefaultPolicy().should_reclaim(capacity, size);
+}
+
+template <class TPolicy>
+inline auto expand_size(const TPolicy& policy, int requested, int previous, int)
+    -> decltype(policy.expand_size(requested, previous))
+{
+    return policy.expand_size(requested, previous);
+}
+
+template <class TPolicy>
+inline int expand_size(const TPolicy&, int requested, int previous, long)
+{
+    return experimental::NetBufDynamicDefaultPolicy().expand_size(requested, previous);
+}
+
+}
+
+namespace experimental {
+
 struct NetBufDynamicChunk : estd::experimental::forward_node_base_base<NetBufDynamicChunk*>
 {
     typedef estd::experimental::forward_node_base_base<NetBufDynamicChunk*> base_type;
     typedef int size_type;
 
+    // number of bytes actually allocated for data, which is what deallocation
+    // is sized by
+    size_type capacity;
+    // logical size, which may be less than capacity after a shrink
     size_type size;
     uint8_t data[];
 
     NetBufDynamicChunk(size_type size) :
         base_type(NULLPTR),
+        capacity(size),
         size(size) {}
 };
 
@@ -58,6 +112,13 @@ public:
     typedef typename estd::intrusive_forward_list<Chunk>::iterator iterator;
 
     Chunk* current;
+    // last chunk in the chain, so that expand() can always append in O(1)
+    // regardless of where current is
+    Chunk* tail;
+
+    // running tallies so that total_size() and friends needn't walk the chain
+    size_type m_total_size;
+    size_type m_chunk_count;
 
     TAllocator get_allocator() { return TAllocator(); }
 
@@ -86,12 +147,48 @@ public:
 
         allocator_traits::deallocate(a,
                                      (uint8_t*)&chunk,
-                                     chunk.size +
+                                     chunk.capacity +
                                      sizeof(Chunk));
     }
 
+    // if policy deems it worthwhile, moves a trimmed chunk into a right-sized allocation
+    // and hands the original back to the allocator.  'previous' is the chunk linking to 'c',
+    // or NULLPTR if 'c' is the front chunk
+    // returns whichever chunk now holds the data
+    Chunk* reclaim(Chunk* previous, Chunk* c)
+    {
+        if(!internal::should_reclaim(get_policy(), c->capacity, c->size, 0)) return c;
+
+        Chunk* relocated = allocate(c->size, true);
+
+        // not fatal, we just keep holding the oversized chunk
+        if(relocated == NULLPTR) return c;
+
+        estd::copy_n(c->data, c->size, relocated->data);
+        relocated->next(c->next());
+
+        if(previous != NULLPTR)
+            previous->next(relocated);
+        else
+        {
+            chunks.pop_front();
+            chunks.push_front(*relocated);
+        }
+
+        allocator_type a = get_allocator();
+
+        deallocate(a, *c);
+
+        return relocated;
+    }
+
 public:
-    NetBufDynamic() : current(NULLPTR) {}
+    NetBufDynamic() :
+        current(NULLPTR),
+        tail(NULLPTR),
+        m_total_size(0),
+        m_chunk_count(0)
+    {}
 
     ~NetBufDynamic()
     {
@@ -130,23 +227,10 @@ public:
         return current->size;
     }
 
-    size_type total_size() const
-    {
-        size_type total = 0;
-
-        // FIX: Can't do const yet because iterator dereference doesn't
-        // have a const version.  When we rememedy this, see about ->
-        // operator too
-        iterator it = chunks.begin();
-
-        while(it != chunks.end())
-        {
-            total += (*it).size;
-            it++;
-        }
+    size_type total_size() const { return m_total_size; }
 
-        return total;
-    }
+    // number of chunks presently allocated
+    size_type chunk_count() const { return m_chunk_count; }
 
     bool next()
     {
@@ -167,118 +251,118 @@ public:
         return false;
     }
 
-    // expand by allocating a brand new chunk of memory
+    // expand by allocating a brand new chunk of memory, appended to the end of the chain
     // auto-next will move our current pointer forward to the newly allocated chunk
     ExpandResult expand(size_type expand_by, bool auto_next)
     {
         // attempt this too, since contiguous is (often) preferred
         //realloc()
 
-        Chunk* allocated = allocate(expand_by);
+        size_type previous = tail == NULLPTR ? 0 : tail->capacity;
+
+        Chunk* allocated = allocate(internal::expand_size(get_policy(), expand_by, previous, 0));
 
         if(allocated == NULLPTR) return ExpandResult::ExpandFailOutOfMemory;
 
+        m_total_size += allocated->size;
+        ++m_chunk_count;
+
         // if we have no chunks at this time
-        if(empty())
+        if(tail == NULLPTR)
         {
             // FIX: Beware, current == NULLPTR but chunks having
             // a value is theoretically valid (think before_begin() )
             // but is not fully thought out here so may behave in an undefined way
             // *except* for next() which has been specially treated to handle
             // this scenario
-            if(auto_next) current = allocated;
-
             chunks.push_front(*allocated);
         }
         else
-        {
-            // TODO:
-            // assert that current != null
+            // always tack on to the very end, even if current has been
+            // repositioned earlier in the chain (i.e. to patch a header)
+            tail->next(allocated);
 
-            // presumes we want to tack on past where we currently are (tack
-            // on to the end)
-            current->next(allocated);
+        tail = allocated;
 
-            if(auto_next)
-                //current = current->next();
-                current = allocated;
-        }
+        if(auto_next) current = allocated;
 
         return ExpandResult::ExpandOKChained;
     }
 
 
     ///
-    /// \brief shrinks last (current) chained buffer to specified size
+    /// \brief shrinks chain down to specified total size
+    ///
+    /// Chunks wholly past to_size are deallocated.  The chunk to_size lands in is trimmed,
+    /// and when policy's should_reclaim agrees, relocated so its surplus capacity is
+    /// released rather than held for the lifetime of the netbuf.  current is left
+    /// on the new last chunk
     /// \param to_size size to shrink to, or 0 to deallocate
     ///
     void shrink_experimental(size_type to_size)
     {
-        if(empty()) return;
-
-        iterator it = chunks.begin();
-
-        size_type tally = (*it).size;
+        if(chunks.empty()) return;
 
         // FIX: going to need to do the ref/non ref dance here
         // for stateful allocators
         allocator_type a = get_allocator();
 
-        // TODO: We need a 'before begin' for this to work right
-        /*
-        if((*it).next() == NULLPTR)
-        {
-            // fake before-begin version
-        } */
-
-        // only enter this loop while we have entire chunks to save
-        while(to_size > tally)
-        {
-            // since to_size is still larger than our current tally, we
-            // move forward through chunks (undefined behavior if to_size
-            // > total_size())
-            Chunk& c = *++it;
-
-            tally += c.size;
-        }
-
-        // we should only arrive here while still having a valid it, meaning we can it++
-        // safely.  we reassign current because shrinking means we are at the last
-        // valid chunk post-shrinkage
-        current = &(*it);
+        Chunk* previous = NULLPTR;
+        Chunk* c = &chunks.front();
+        Chunk* to_free;
 
-        if(to_size == tally)
+        if(to_size == 0)
         {
-            // don't need to shrink, exact match after
+            to_free = c;
+            while(!chunks.empty()) chunks.pop_front();
+            current = NULLPTR;
+            tail = NULLPTR;
+            m_total_size = 0;
+            m_chunk_count = 0;
         }
         else
         {
-            // FIX: this is not going to place nice with all deallocators, because
-            // it will be passing wrong size into deallocation.  What
-            // we really need to do is a realloc here, but that gets complicated
-            // because we have to potentially reinsert the item into the linked
-            // list (node + data allocated together and a realloc could change pointer
-            // location)
-            current->size -= tally - to_size;
-        }
+            size_type tally = c->size;
+            size_type kept = 1;
 
-        iterator del_after = it++;
+            // skip over chunks who fit entirely within to_size
+            while(to_size > tally && c->next() != NULLPTR)
+            {
+                previous = c;
+                c = c->next();
+                tally += c->size;
+                ++kept;
+            }
 
-        // now that we've skipped allocated chunks who fit, loop
-        // over ones who are gonna be deleted because of the shrink
-        while(it != chunks.end())
+            to_free = c->next();
+            c->next(NULLPTR);
+
+            // a to_size larger than total_size() leaves the last chunk as-is
+            if(to_size < tally)
+            {
+                c->size -= tally - to_size;
+                tally = to_size;
+                c = reclaim(previous, c);
+            }
+
+            current = c;
+            tail = c;
+            m_total_size = tally;
+            m_chunk_count = kept;
+        }
+
+        // deallocate chunks which fell off the end due to the shrink
+        while(to_free != NULLPTR)
         {
-            // NOTE: Should we expect destructor to run here? Hmm, that would be bad
-            // http://www.cplusplus.com/reference/forward_list/forward_list/erase_after/ indicates yes
-            chunks.erase_after(del_after++);
+            Chunk* next = to_free->next();
 
-            iterator to_del = it++;
+            deallocate(a, *to_free);
 
-            deallocate(a, *to_del);
+            to_free = next;
         }
     }
 
-    bool last()
+    bool last() const
     {
         if(!empty()) { return current->next() == NULLPTR; }
         return true;
@@ -289,6 +373,11 @@ public:
     {
         current = &chunks.front();
     }
+
+    typedef Chunk* mark_type;
+
+    mark_type mark() const { return current; }
+    void restore(mark_type m) { current = m; }
 };
 
 }
@@ -0,0 +1,176 @@
+/**
+ *  @file
+ *  Zero-copy scatter/gather view across any netbuf chain
+ *
+ *  Presents each chunk of a netbuf as an estd::span segment, so that the whole
+ *  chain can be handed off in one shot (writev/sendmsg, checksum kernels, etc)
+ *  rather than walked chunk by chunk via reset()/next()
+ */
+#pragma once
+
+#include "netbuf.h"
+
+namespace embr { namespace mem {
+
+namespace internal {
+
+///
+/// \brief visits each non-empty chunk of netbuf's chain, from the beginning
+///
+/// Netbuf is repositioned back onto the chunk it was on when called, so this is safe to use
+/// mid-read or mid-write.  Note that for netbufs which can't reset (i.e. non-chain pbuf)
+/// only the current chunk onward is visited
+///
+/// \param f functor taking (const void* data, size_type size), returning false to stop early
+/// \return false if f stopped the walk early
+///
+template <class TNetBuf, class F>
+bool for_each_chunk(TNetBuf& netbuf, F& f)
+{
+    // nothing to visit, and a chunkless netbuf (i.e. fresh NetBufDynamic) can't
+    // necessarily reset() or report data() at all
+    if(netbuf.total_size() == 0) return true;
+
+    typename TNetBuf::mark_type here = netbuf.mark();
+    bool completed = true;
+
+    netbuf.reset();
+
+    for(;;)
+    {
+        if(netbuf.size() > 0 && !f(netbuf.data(), netbuf.size()))
+        {
+            completed = false;
+            break;
+        }
+
+        if(!netbuf.next()) break;
+    }
+
+    netbuf.restore(here);
+
+    return completed;
+}
+
+}
+
+namespace experimental {
+
+///
+/// \brief fixed-capacity array of spans, one per netbuf chunk
+///
+/// \tparam N maximum number of segments to gather.  Chains longer than this are reported
+/// via truncated()
+/// \tparam T use uint8_t (non const) for a scatter view to receive into
+///
+template <size_t N, class T = const uint8_t>
+class NetBufGatherView
+{
+public:
+    typedef estd::span<T> segment_type;
+    typedef size_t size_type;
+
+private:
+    struct Entry
+    {
+        T* data;
+        size_type size;
+    };
+
+    Entry entries[N];
+    size_type m_count;
+    // total bytes across all gathered segments
+    size_type m_total_size;
+    bool m_truncated;
+
+    struct Collector
+    {
+        NetBufGatherView& view;
+
+        Collector(NetBufGatherView& view) : view(view) {}
+
+        template <class TSize>
+        bool operator()(const void* data, TSize size)
+        {
+            if(view.m_count == N)
+            {
+                view.m_truncated = true;
+                return false;
+            }
+
+            Entry& e = view.entries[view.m_count++];
+
+            e.data = static_cast<T*>(const_cast<void*>(data));
+            e.size = size;
+            view.m_total_size += size;
+
+            return true;
+        }
+    };
+
+public:
+    NetBufGatherView() :
+        m_count(0),
+        m_total_size(0),
+        m_truncated(false)
+    {}
+
+    template <class TNetBuf>
+    explicit NetBufGatherView(TNetBuf& netbuf)
+    {
+        gather(netbuf);
+    }
+
+    void clear()
+    {
+        m_count = 0;
+        m_total_size = 0;
+        m_truncated = false;
+    }
+
+    ///
+    /// \brief (re)populates segments from the entire netbuf chain
+    /// \return false if chain had more than N chunks, in which case only the first N are present
+    ///
+    template <class TNetBuf>
+    bool gather(TNetBuf& netbuf)
+    {
+        clear();
+
+        Collector c(*this);
+
+        return internal::for_each_chunk(netbuf, c);
+    }
+
+    size_type size() const { return m_count; }
+    bool empty() const { return m_count == 0; }
+    static CONSTEXPR size_type max_size() { return N; }
+    size_type total_size() const { return m_total_size; }
+    bool truncated() const { return m_truncated; }
+
+    segment_type operator[](size_type i) const
+    {
+        return segment_type(entries[i].data, entries[i].size);
+    }
+
+    ///
+    /// \brief fills out a caller-provided iovec style array (anything with iov_base and iov_len)
+    /// suitable for writev/sendmsg.  iov must have room for size() elements
+    /// \return number of iov elements filled
+    ///
+    template <class TIovec>
+    size_type export_to(TIovec* iov) const
+    {
+        for(size_type i = 0; i < m_count; i++)
+        {
+            iov[i].iov_base = (void*)entries[i].data;
+            iov[i].iov_len = entries[i].size;
+        }
+
+        return m_count;
+    }
+};
+
+}
+
+}}
@@ -7,6 +7,7 @@
 
 #include <estd/span.h>
 #include "netbuf.h"
+#include "internal/endian.h"
 
 namespace embr { namespace mem {
 
@@ -33,6 +34,11 @@ public:
     NetBufReader(TArgs&&...args) :
         base(std::forward<TArgs>(args)...)
     {}
+#else
+    NetBufReader() {}
+
+    template <class TParam1>
+    NetBufReader(TParam1& p) : base(p) {}
 #endif
 
     const_buffer buffer() const
@@ -41,7 +47,52 @@ public:
                                   netbuf().size() - base::m_pos);
     }
 
-    bool next() { return netbuf().next(); }
+    // moves to next chunk, reading from its beginning
+    bool next()
+    {
+        if(!base::m_netbuf.next()) return false;
+
+        base::m_pos = 0;
+        return true;
+    }
+
+    ///
+    /// \brief reads network order unsigned integer
+    ///
+    /// Single unaligned load when value lies entirely in current chunk, otherwise bytes are
+    /// stitched together across chunk boundary
+    /// \return false if chain ended first
+    ///
+    template <class TUInt>
+    bool read_big_endian(TUInt& value)
+    {
+        const_buffer b = buffer();
+
+        if(b.size() >= sizeof(TUInt))
+        {
+            value = embr::internal::load_big_endian<TUInt>(b.data());
+            base::m_pos += sizeof(TUInt);
+            return true;
+        }
+
+        TUInt v = 0;
+
+        for(unsigned i = 0; i < sizeof(TUInt); i++)
+        {
+            while(buffer().size() == 0)
+                if(!next()) return false;
+
+            v = (TUInt)((v << 8) | buffer()[0]);
+            base::m_pos++;
+        }
+
+        value = v;
+        return true;
+    }
+
+    bool read_u16(uint16_t& value) { return read_big_endian(value); }
+    bool read_u32(uint32_t& value) { return read_big_endian(value); }
+    bool read_u64(uint64_t& value) { return read_big_endian(value); }
 };
 
 template <class TNetBuf>
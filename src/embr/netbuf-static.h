@@ -54,6 +54,12 @@ public:
 
     // position back at the beginning
     void reset() {}
+
+    // only one chunk, so nothing to remember
+    typedef bool mark_type;
+
+    mark_type mark() const { return true; }
+    void restore(mark_type) {}
 };
 
 }
@@ -106,6 +112,12 @@ public:
 
     // position back at the beginning
     void reset() {}
+
+    // only one chunk, so nothing to remember
+    typedef bool mark_type;
+
+    mark_type mark() const { return true; }
+    void restore(mark_type) {}
 };
 
 }
@@ -115,6 +127,7 @@ struct NetBufTraits<layer1::NetBuf<N> >
 {
     static CONSTEXPR bool can_chain() { return false; }
     static CONSTEXPR bool can_expand() { return false; }
+    static CONSTEXPR bool can_reset() { return true; }
 };
 
 template <size_t N>
@@ -122,6 +135,7 @@ struct NetBufTraits<layer2::NetBuf<N> >
 {
     static CONSTEXPR bool can_chain() { return false; }
     static CONSTEXPR bool can_expand() { return true; }
+    static CONSTEXPR bool can_reset() { return true; }
 };
 
 
@@ -2,40 +2,52 @@
 
 #include <estd/span.h>
 #include "netbuf.h"
+#include "internal/endian.h"
+#include "format.h"
 
-#ifdef FEATURE_C_ITOA
-#include <stdlib.h>
-#endif
+#include <string.h>
 
 
 namespace embr { namespace mem {
 
+namespace experimental {
+
+// growth policy (see netbuf.h) NetBufWriter applies to next() requests
+typedef PaddedGrowthPolicy<8> NetBufWriterDefaultPolicy;
+
+}
+
 
 // TODO: writer is potentially going to need all that ostream stuff
 // so keep << unfancy until we finish porting in util.embedded ostream, then make
 // NetBufWriter an actual participant in that space
-template <class TNetBuf, class TPolicy = void>
+template <class TNetBuf, class TPolicy = experimental::NetBufWriterDefaultPolicy>
 class NetBufWriter : public internal::NetBufWrapper<TNetBuf>
 {
     typedef internal::NetBufWrapper<TNetBuf> base;
 
-    template <class _TNetBuf>
-    friend NetBufWriter<_TNetBuf>& operator <<(NetBufWriter<_TNetBuf>& reader, uint8_t value);
-
 public:
     typedef typename base::netbuf_type netbuf_type;
     typedef typename base::size_type size_type;
     typedef typename estd::span<uint8_t> mutable_buffer;
+    typedef TPolicy policy_type;
 
 protected:
     netbuf_type& netbuf() { return base::m_netbuf; }
 
+    policy_type get_policy() const { return policy_type(); }
+
 public:
 #ifdef FEATURE_CPP_MOVESEMANTIC
     template <class ...TArgs>
     NetBufWriter(TArgs&&...args) :
         base(std::forward<TArgs>(args)...)
     {}
+#else
+    NetBufWriter() {}
+
+    template <class TParam1>
+    NetBufWriter(TParam1& p) : base(p) {}
 #endif
 
     mutable_buffer buffer()
@@ -51,8 +63,9 @@ public:
     // if some but not all memory could be allocated
     bool next(size_type by_amount)
     {
-        // TODO: Make this by_amount padding come direct from policy
-        by_amount += 8; // room to grow without having to reallocate
+        // policy may ask for more than by_amount, so that subsequent small writes
+        // don't each need their own chunk.  Current chunk size serves as the hint
+        by_amount = get_policy().expand_size(by_amount, (size_type)netbuf().size());
 
         switch(netbuf().expand(by_amount, true))
         {
@@ -69,77 +82,201 @@ public:
         }
     }
 
-    bool write(const estd::const_buffer& b)
+    ///
+    /// \brief zero copy write: at least n contiguous writable bytes at current position
+    ///
+    /// Moves on to a new chunk or expands linearly if the current one can't hold n.  Write
+    /// into the returned buffer, then commit() however many bytes were actually used.
+    /// Empty if n contiguous bytes can't be had.  Notably, a chained netbuf whose current
+    /// chunk is partly filled yields empty, since moving on would leave the rest of this chunk
+    /// as a hole amidst the data.  Fall back to write() then, which fills out this chunk first
+    ///
+    mutable_buffer reserve(size_type n)
     {
-        return false;
+        mutable_buffer b = buffer();
+        size_type available = (size_type)b.size();
+
+        if(available >= n) return b;
+
+        if(available > 0 && NetBufTraits<netbuf_type>::can_chain())
+            return mutable_buffer(NULLPTR, 0);
+
+        if(!next(n - available)) return mutable_buffer(NULLPTR, 0);
+
+        b = buffer();
+
+        if((size_type)b.size() < n) return mutable_buffer(NULLPTR, 0);
+
+        return b;
     }
-};
 
+    // marks k bytes of reserve()'d space as written.  k is clamped to what's left
+    // of current chunk
+    // \return number of bytes actually committed
+    size_type commit(size_type k)
+    {
+        size_type remaining = (size_type)buffer().size();
 
-template <class TNetBuf>
-NetBufWriter<TNetBuf>& operator <<(NetBufWriter<TNetBuf>& writer, const estd::const_buffer& copy_from)
-{
-    estd::mutable_buffer b = writer.buffer();
-    typedef typename NetBufWriter<TNetBuf>::size_type size_type;
+        if(k > remaining) k = remaining;
 
-    size_type copy_from_size = copy_from.size();
-    typedef estd::const_buffer::iterator iterator;
-    iterator copy_from_begin = copy_from.begin();
+        base::m_pos += k;
 
-    // while source copy from buffer exceeds available netbuf size
-    while(copy_from_size > b.size())
+        return k;
+    }
+
+    ///
+    /// \brief writes network order unsigned integer
+    ///
+    /// Single unaligned store when it fits in current chunk, otherwise bytes are split
+    /// across chunk boundary, expanding as needed
+    /// \return false if netbuf couldn't hold all of value
+    ///
+    template <class TUInt>
+    bool write_big_endian(TUInt value)
     {
-        // fill remainder of current chunk up completely
-        std::copy(copy_from_begin, copy_from_begin + b.size(), b.begin());
+        mutable_buffer b = buffer();
 
-        // move through copy_from by netbuf chunk size
-        copy_from_begin += b.size();
-        copy_from_size -= b.size();
+        if(b.size() >= sizeof(TUInt))
+        {
+            embr::internal::store_big_endian(b.data(), value);
+            base::m_pos += sizeof(TUInt);
+            return true;
+        }
 
-        // advance to next chunk, asking for (remaining) size we really need
-        if (!writer.next(copy_from_size))
+        for(int shift = (sizeof(TUInt) - 1) * 8; shift >= 0; shift -= 8)
         {
-            // ASSERT some kind of problem
+            if(buffer().size() == 0 && !next((shift / 8) + 1))
+                return false;
+
+            buffer()[0] = (uint8_t)(value >> shift);
+            base::m_pos++;
         }
 
-        // acquire buffer moved to by 'next' operation
-        b = writer.buffer();
+        return true;
     }
 
-    std::copy(copy_from_begin, copy_from.end(), b.begin());
+    bool write_u16(uint16_t value) { return write_big_endian(value); }
+    bool write_u32(uint32_t value) { return write_big_endian(value); }
+    bool write_u64(uint64_t value) { return write_big_endian(value); }
+
+    ///
+    /// \brief copies n bytes in, moving on to new chunks (or expanding) as needed
+    ///
+    /// \param hint how much to ask for when expanding, if more than n is known to be coming
+    /// \return number of bytes written, less than n only if netbuf couldn't grow enough
+    ///
+    size_type write(const void* data, size_type n, size_type hint = 0)
+    {
+        const uint8_t* s = static_cast<const uint8_t*>(data);
+        size_type remaining = n;
+
+        if(hint < n) hint = n;
+
+        for(;;)
+        {
+            mutable_buffer b = buffer();
+            size_type available = (size_type)b.size();
+            size_type sz = available < remaining ? available : remaining;
+
+            // netbuf with no chunks yet has null data()
+            if(sz > 0) memcpy(b.data(), s, sz);
+            base::m_pos += sz;
+            s += sz;
+            remaining -= sz;
+            hint -= sz;
+
+            if(remaining == 0) return n;
+
+            if(!next(hint)) return n - remaining;
+        }
+    }
+
+    // \return number of bytes written, less than b.size() only if netbuf couldn't grow enough
+    size_type write(const estd::const_buffer& b)
+    {
+        return write(b.data(), b.size());
+    }
+
+    ///
+    /// \brief gathers several buffers in one go
+    ///
+    /// Expansions ask for everything still to come, so a chained netbuf gains at most
+    /// one chunk rather than one per buffer
+    /// \return total bytes written, stopping at first buffer which couldn't fully be written
+    ///
+    size_type write(const estd::const_buffer* buffers, size_t count)
+    {
+        size_type total = 0;
+
+        for(size_t i = 0; i < count; i++) total += buffers[i].size();
+
+        size_type written = 0;
+
+        for(size_t i = 0; i < count; i++)
+        {
+            size_type sz = buffers[i].size();
+            size_type w = write(buffers[i].data(), sz, total - written);
+
+            written += w;
+
+            if(w < sz) break;
+        }
+
+        return written;
+    }
+
+    template <size_t N>
+    size_type write(const estd::const_buffer (&buffers)[N])
+    {
+        return write(buffers, N);
+    }
+};
+
+
+// NOTE: a short write (netbuf couldn't grow) is silent here.  Use write() to detect it
+template <class TNetBuf, class TPolicy>
+NetBufWriter<TNetBuf, TPolicy>& operator <<(NetBufWriter<TNetBuf, TPolicy>& writer, const estd::const_buffer& copy_from)
+{
+    writer.write(copy_from);
 
     return writer;
 }
 
-template <class TNetBuf>
-NetBufWriter<TNetBuf>& operator <<(NetBufWriter<TNetBuf>& writer, uint8_t value)
+template <class TNetBuf, class TPolicy>
+NetBufWriter<TNetBuf, TPolicy>& operator <<(NetBufWriter<TNetBuf, TPolicy>& writer, uint8_t value)
 {
-    // FIX: Not ready for prime time, notice how we don't bump pos forward
-    uint8_t* data = reinterpret_cast<uint8_t*>(writer.netbuf().data());
-    data[0] = value;
+    writer.write(&value, 1);
+
     return writer;
 }
 
 namespace experimental {
 
-template <class TNetBuf>
-void itoa(NetBufWriter<TNetBuf>& writer, int value, int base = 10)
+///
+/// \brief writes textual representation of value, spilling onto further chunks as needed
+/// \param base 2 - 36
+/// \return false if netbuf couldn't hold all of it, or if base is out of range - in which
+/// case nothing is written
+///
+template <class TNetBuf, class TPolicy>
+bool itoa(NetBufWriter<TNetBuf, TPolicy>& writer, int value, int base = 10)
 {
-    estd::mutable_buffer b = writer.buffer();
-#ifdef FEATURE_C_ITOA
-    // FIX: untested
-    itoa(value, (char*)b.data(), base);
-#else
-    if(base == 10)
-    {
-        // TODO: Check for size of int string, ideally we'd account for:
-        // - char_traits for unicode
-        // - maximum size of this platform's int value (which I believe some helpers are floating somewhere in estd)
-        // - of course we have to account for discarded null termination
-        int advance_by = sprintf((char*) b.data(), "%d", value);
-        writer.advance(advance_by);
-    }
-#endif
+    // base 0 would divide by zero, base 1 never terminates
+    if(base < 2 || base > 36) return false;
+
+    if(base == 10) return embr::experimental::write_decimal(writer, value);
+
+    // worst case is base 2 plus sign
+    char buf[sizeof(int) * 8 + 1];
+    char* p = buf;
+
+    if(value < 0) *p++ = '-';
+
+    unsigned magnitude = value < 0 ? 0U - (unsigned)value : (unsigned)value;
+
+    p = embr::internal::format_unsigned(p, magnitude, (unsigned)base);
+
+    return embr::internal::put_chars(writer, buf, p - buf);
 }
 
 }
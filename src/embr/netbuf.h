@@ -5,6 +5,7 @@
 #pragma once
 
 #include <estd/span.h>
+#include <estd/type_traits.h>
 //#include <estd/ios.h>
 
 /*
@@ -22,13 +23,47 @@
  *      expand(size_type by_amount, bool auto_next) = attempt to expand netbuf size
  *      bool last() = check to see if this is the last nextbuf
  *      bool next() = attempt to move forward in a netbuf chain (only relevant for chained, prepopulated netbuf)
+ *      void reset() = move back to first chunk.  May be a no-op, see NetBufTraits::can_reset
+ *      mark_type mark() = opaque handle on current chunk
+ *      void restore(mark_type) = move back onto a chunk previously mark()ed
  */
 
 namespace embr { namespace mem {
 
 
+// compile time description of a netbuf.  Unspecialized netbufs are assumed to be capable
+// of everything, which is always safe if not always fastest
 template <class TNetBuf>
-class NetBufTraits;
+struct NetBufTraits
+{
+    static CONSTEXPR bool can_chain() { return true; }
+    static CONSTEXPR bool can_expand() { return true; }
+    // false when reset() can't actually get back to first chunk
+    static CONSTEXPR bool can_reset() { return true; }
+};
+
+namespace internal {
+
+// true_type when TNetBuf is known to always be one contiguous chunk, letting consumers
+// skip next()/chain handling altogether
+#ifdef FEATURE_CPP_CONSTEXPR
+template <class TNetBuf>
+struct netbuf_is_contiguous :
+    estd::integral_constant<bool, !NetBufTraits<TNetBuf>::can_chain()> {};
+// true_type when TNetBuf grows by expanding its one chunk in place, i.e. realloc style
+template <class TNetBuf>
+struct netbuf_expands_in_place :
+    estd::integral_constant<bool, !NetBufTraits<TNetBuf>::can_chain() &&
+        NetBufTraits<TNetBuf>::can_expand()> {};
+#else
+template <class TNetBuf>
+struct netbuf_is_contiguous : estd::false_type {};
+
+template <class TNetBuf>
+struct netbuf_expands_in_place : estd::false_type {};
+#endif
+
+}
 
 enum ExpandResult
 {
@@ -61,6 +96,64 @@ template <>
 struct NetBufMetadata<false> {};
 
 
+// Growth policies decide how much to really expand a netbuf by, given the amount
+// requested and the size of the chunk most recently allocated or filled (0 if none).
+// Asking for more than requested up front means fewer, larger chunks when a
+// payload is written in many small pieces
+
+// requested amount, nothing more
+struct ExactGrowthPolicy
+{
+    template <class TSize>
+    TSize expand_size(TSize requested, TSize) const { return requested; }
+};
+
+// requested amount plus a little room to grow
+template <int pad = 8>
+struct PaddedGrowthPolicy
+{
+    template <class TSize>
+    TSize expand_size(TSize requested, TSize) const { return requested + pad; }
+};
+
+// at least as large as the previous chunk
+struct HintGrowthPolicy
+{
+    template <class TSize>
+    TSize expand_size(TSize requested, TSize previous) const
+    {
+        return requested > previous ? requested : previous;
+    }
+};
+
+// starts at 'initial' then doubles previous chunk, capped at 'maximum'.
+// never less than requested
+template <int initial = 128, int maximum = 2048>
+struct GeometricGrowthPolicy
+{
+    template <class TSize>
+    TSize expand_size(TSize requested, TSize previous) const
+    {
+        TSize grow_by = previous == 0 ? TSize(initial) : TSize(previous * 2);
+
+        if(grow_by > TSize(maximum)) grow_by = maximum;
+
+        return requested > grow_by ? requested : grow_by;
+    }
+};
+
+// always 'chunk_size' (i.e. an MTU), unless requested is larger
+template <int chunk_size>
+struct FixedGrowthPolicy
+{
+    template <class TSize>
+    TSize expand_size(TSize requested, TSize) const
+    {
+        return requested > TSize(chunk_size) ? requested : TSize(chunk_size);
+    }
+};
+
+
 }
 
 namespace internal {
@@ -86,14 +179,20 @@ protected:
     // has same indirect relation to 'total_size'
     size_type m_pos;
 
+    NetBufWrapper() : m_pos(0) {}
+
 #ifdef FEATURE_CPP_MOVESEMANTIC
     template <class ...TArgs>
     NetBufWrapper(TArgs&&...args) :
         m_netbuf(std::forward<TArgs>(args)...),
         m_pos(0)
     {}
-
-    NetBufWrapper() = default;
+#else
+    template <class TParam1>
+    NetBufWrapper(TParam1& p) :
+        m_netbuf(p),
+        m_pos(0)
+    {}
 #endif
 
 public:
@@ -103,10 +202,13 @@ public:
     // 'end' for static netbuf but realizing array has a 'last' call too...
     bool last() const { return m_netbuf.last(); }
 
+    // moves forward within current chunk, no further than its end
     size_type advance(size_type by_amount)
     {
-        if(m_netbuf.size() < by_amount)
-            by_amount = m_netbuf.size();
+        size_type remaining = m_netbuf.size() - m_pos;
+
+        if(remaining < by_amount)
+            by_amount = remaining;
 
         m_pos += by_amount;
 
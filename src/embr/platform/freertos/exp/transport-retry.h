@@ -16,13 +16,17 @@
 #include <estd/forward_list.h>
 #include <estd/algorithm.h>
 
+#include "../../../exp/hash-index.h"
+
 #ifdef ESP_PLATFORM
 #include <freertos/FreeRTOS.h>
+#include <freertos/semphr.h>
 #include <freertos/timers.h>
 #else
 #if defined(UNIT_TESTING) and !defined(ESTD_FREERTOS)
 // do nothing here, for GNU testing of this FreeRTOS specific area
 #else
+#include <semphr.h>
 #include <timers.h>
 #endif
 #endif
@@ -39,7 +43,12 @@ struct FreeRTOSTimer
 // We expect TRetryPolicyImpl to help us choose how long retry delays are as well
 //    as how many times to retry, and how to compare our streambuf to incoming
 //    streambuf to make sure it's an app-specific match (e.g. matching on CoAP MID)
-template <class TTransport, class TRetryPolicyImpl, class TTimer = FreeRTOSTimer>
+// index_slots (power of 2) bounds the key index used to match replies.  Items beyond
+//    what it holds are kept on an overflow list, and matched by searching it
+// Timer callbacks run on the FreeRTOS timer service task, so tracking structures are
+//    guarded by a mutex shared with send/acknowledge/remove on the app side
+template <class TTransport, class TRetryPolicyImpl, class TTimer = FreeRTOSTimer,
+          size_t index_slots = 32>
 struct RetryManager
 {
     TRetryPolicyImpl policy_impl;
@@ -60,10 +69,20 @@ struct RetryManager
     }
 
 
+#if defined(UNIT_TESTING) and !defined(ESTD_FREERTOS)
+    typedef typename TTimer::handle_type timer_handle_type;
+#else
+    typedef TimerHandle_t timer_handle_type;
+#endif
+
     struct QueuedItem : 
         estd::experimental::forward_node_base_base<QueuedItem*>,
         item_policy_impl_type
     {
+        // so that timer callback can untrack an item whose retries are exhausted
+        RetryManager* manager;
+        // drives retransmission of this item, so that remove() can stop it
+        timer_handle_type timer;
         // endpoint that we want to send to.  For ipv4 this is IP address and port
         endpoint_type endpoint;
         // streambuf to (repeatedly) send to aforementioned endpoint
@@ -72,10 +91,12 @@ struct RetryManager
         // NOTE: may or may not want to cache this here, but probably yes
         key_type key;
 
-        QueuedItem(const endpoint_type& endpoint, 
+        QueuedItem(RetryManager* manager,
+            const endpoint_type& endpoint, 
             ostreambuf_type& streambuf,
             key_type key) :
             estd::experimental::forward_node_base_base<QueuedItem*>(nullptr),
+            manager(manager),
             endpoint(endpoint),
             streambuf(streambuf),
             retry_count(0),
@@ -90,30 +111,152 @@ struct RetryManager
     static std::allocator<QueuedItem> stub;
     static std::allocator<QueuedItem>& allocator() { return stub; }
 
+    // only items which didn't fit in index live here
     typedef estd::intrusive_forward_list<QueuedItem> list_type;
     typedef typename list_type::iterator list_iterator;
-    list_type items;
+    list_type overflow;
+
+    // NOTE: Endpoint doesn't participate in hash, since policy_impl.match may
+    // deliberately disregard parts of it (i.e. port)
+    static uint32_t hash(const key_type& key)
+    {
+        return key_hash<key_type>::hash(key);
+    }
+
+    HashIndex<QueuedItem, index_slots> index;
+    // items which didn't fit in index, i.e. length of 'overflow'
+    size_t unindexed = 0;
+
+    // average probe length grows with this - consider more index_slots once it
+    // regularly exceeds ~0.7
+    float load_factor() const { return index.load_factor(); }
+
+    struct Mutex
+    {
+#ifdef ESTD_FREERTOS
+        SemaphoreHandle_t handle;
+
+        Mutex() : handle(xSemaphoreCreateMutex()) {}
+        ~Mutex() { vSemaphoreDelete(handle); }
+
+        void lock() { xSemaphoreTake(handle, portMAX_DELAY); }
+        void unlock() { xSemaphoreGive(handle); }
+#else
+        void lock() {}
+        void unlock() {}
+#endif
+    };
+
+    struct LockGuard
+    {
+        Mutex& m;
+
+        LockGuard(Mutex& m) : m(m) { m.lock(); }
+        ~LockGuard() { m.unlock(); }
+    };
+
+    // guards index and overflow.  Shared by all managers of this type, so that timer
+    // callback can take it without first dereferencing an item which may be gone
+    static Mutex& mutex()
+    {
+        static Mutex m;
+        return m;
+    }
+
+    // caller holds mutex
+    void track(QueuedItem* item)
+    {
+        if(!index.insert(item, hash(item->key)))
+        {
+            overflow.push_front(*item);
+            ++unindexed;
+        }
+    }
+
+    // caller holds mutex
+    // \return false if item wasn't in 'overflow'
+    bool unlink_overflow(QueuedItem* item)
+    {
+        list_iterator i = overflow.first();
+
+        if(i == overflow.last()) return false;
+
+        if(&(*i) == item)
+        {
+            overflow.pop_front();
+            return true;
+        }
+
+        for(list_iterator previous = i++; i != overflow.last(); previous = i++)
+        {
+            if(&(*i) == item)
+            {
+                overflow.erase_after(previous);
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    // caller holds mutex.  Indexed items come out in O(1), only overflowed ones
+    // need a search
+    // \return false if item wasn't being tracked
+    bool untrack(QueuedItem* item)
+    {
+        if(index.erase(item, hash(item->key))) return true;
+
+        if(!unlink_overflow(item)) return false;
+
+        --unindexed;
+        return true;
+    }
+
+    // caller holds mutex
+    template <class F>
+    QueuedItem* find(key_type key, F match)
+    {
+        QueuedItem* found = index.find(hash(key), match);
+
+        if(found != NULLPTR || unindexed == 0) return found;
+
+        list_iterator i = estd::find_if(overflow.first(), overflow.last(),
+            [&](const QueuedItem& item) { return match(&item); });
+
+        return i == overflow.last() ? NULLPTR : &(*i);
+    }
 
 #ifdef ESTD_FREERTOS
     // TODO: Do "anchoring" so that timebase is yanked back from drifting
     static void timer_callback(TimerHandle_t xTimer)
     {
+        // Runs on timer service task.  ID is cleared by remove() under mutex, so
+        // once we hold it a null ID means item already went back to its owner
+        // and mustn't be touched
+        LockGuard guard(mutex());
+
         QueuedItem* item = (QueuedItem*) pvTimerGetTimerID(xTimer);
 
+        if(item == NULLPTR) return;
+
         item->process_timeout();
 
         if(item->retry_done())
         {
-            xTimerDelete(xTimer, 10);
+            // untrack first, otherwise index and overflow would go on referring to freed item
+            item->manager->untrack(item);
+            // never block on the timer task itself
+            xTimerDelete(xTimer, 0);
             //delete item;
             allocator_traits::destroy(allocator(), item);
+            allocator_traits::deallocate(allocator(), item, 1);
             return;
         }
 
         // in ms
         timebase_type expiry = item->get_new_expiry();
 
-        BaseType_t result = xTimerChangePeriod(xTimer, pdMS_TO_TICKS(expiry), 10);
+        BaseType_t result = xTimerChangePeriod(xTimer, pdMS_TO_TICKS(expiry), 0);
 
         if(result == pdFALSE)
         {
@@ -131,23 +274,29 @@ struct RetryManager
         // memory pools and the like
         //QueuedItem* item = new QueuedItem(to, streambuf, key);
         QueuedItem* item = allocator_traits::allocate(allocator(), 1);
-        allocator_traits::construct(allocator(), item, to, streambuf, key);
-
-        items.push_front(*item);
+        allocator_traits::construct(allocator(), item, this, to, streambuf, key);
 
         //timebase_type relative_expiry = policy_impl.get_relative_expiry(*item);
         timebase_type relative_expiry = item->get_new_expiry();
 
+        {
+            LockGuard guard(mutex());
+
 #if defined(UNIT_TESTING) and !defined(ESTD_FREERTOS)
-        timer_impl.create(relative_expiry, item);
+            item->timer = timer_impl.create(relative_expiry, item);
 #else
-        TimerHandle_t timer = xTimerCreate("retry",
-            pdMS_TO_TICKS(relative_expiry),
-            pdFALSE,
-            item,
-            timer_callback);
+            item->timer = xTimerCreate("retry",
+                pdMS_TO_TICKS(relative_expiry),
+                pdFALSE,
+                item,
+                timer_callback);
+#endif
 
-        BaseType_t result = xTimerStart(timer, 0);
+            track(item);
+        }
+
+#if !(defined(UNIT_TESTING) and !defined(ESTD_FREERTOS))
+        xTimerStart(item->timer, 0);
 #endif
     }
 
@@ -162,24 +311,102 @@ struct RetryManager
     // Shall need an app-specific identifier, endpoint alone is not enough
     // (generally) to distinguish whether this is the specific item in question
     // streambuf will need inspection (for CoAP, we'll be looking for MID)
-    void evaluate_received(const endpoint_type& from, istreambuf_type& streambuf)
+    // \return item which was acknowledged, now caller's to dispose of, or null
+    QueuedItem* evaluate_received(const endpoint_type& from, istreambuf_type& streambuf)
     {
         key_type key = extract_key(streambuf);
 
-        evaluate_received(from, key);
+        return acknowledge(from, key);
     }
 
-    void evaluate_received(const endpoint_type& from, key_type key)
+    // \return queued item which 'from' and 'key' are a reply to, or null.  Item remains
+    // tracked, so its retries may exhaust (and free it) at any time - prefer acknowledge()
+    QueuedItem* evaluate_received(const endpoint_type& from, key_type key)
     {
-        list_iterator found = estd::find_if(items.first(), items.last(),
-            [&](const QueuedItem& item)  
-            {
-                // policy impl helps for IP to compare only addr part, not port part
-                bool addr_match = policy_impl.match(from, item.endpoint);
-                return addr_match && item.key == key; 
-            });
+        LockGuard guard(mutex());
+
+        return find(key, matcher(from, key));
+    }
+
+    // finds and removes in one step, so that timer task can't free item in between
+    // \return item which 'from' and 'key' are a reply to, now caller's to dispose of, or null
+    QueuedItem* acknowledge(const endpoint_type& from, key_type key)
+    {
+        QueuedItem* found;
+
+        {
+            LockGuard guard(mutex());
+
+            found = find(key, matcher(from, key));
+
+            if(found == NULLPTR) return NULLPTR;
+
+            untrack(found);
+            disarm(found);
+        }
+
+        stop_timer(found);
+
+        return found;
+    }
+
+    // stop tracking item, i.e. once it's been acknowledged or retries are exhausted.
+    // Its timer is stopped too, so item itself is left for caller to dispose of
+    // \return false if item wasn't being tracked, i.e. already removed or never sent
+    bool remove(QueuedItem* item)
+    {
+        {
+            LockGuard guard(mutex());
+
+            if(!untrack(item)) return false;
+
+            disarm(item);
+        }
+
+        stop_timer(item);
+
+        return true;
+    }
+
+private:
+    struct Matcher
+    {
+        RetryManager* manager;
+        const endpoint_type& from;
+        key_type key;
+
+        bool operator()(const QueuedItem* item) const
+        {
+            // policy impl helps for IP to compare only addr part, not port part
+            bool addr_match = manager->policy_impl.match(from, item->endpoint);
+            return addr_match && item->key == key;
+        }
+    };
+
+    Matcher matcher(const endpoint_type& from, key_type key)
+    {
+        return Matcher{ this, from, key };
+    }
+
+    // caller holds mutex.  Tells a callback already underway to leave item alone
+    void disarm(QueuedItem* item)
+    {
+#if !(defined(UNIT_TESTING) and !defined(ESTD_FREERTOS))
+        vTimerSetTimerID(item->timer, NULLPTR);
+#endif
+    }
+
+    // called without mutex, since timer task may be waiting on it while our delete
+    // command waits on timer task
+    void stop_timer(QueuedItem* item)
+    {
+#if defined(UNIT_TESTING) and !defined(ESTD_FREERTOS)
+        timer_impl.destroy(item->timer);
+#else
+        xTimerDelete(item->timer, portMAX_DELAY);
+#endif
     }
 };
 
 
-}}
\ No newline at end of file
+}}
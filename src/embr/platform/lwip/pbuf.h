@@ -239,6 +239,12 @@ public:
 #endif
     }
 
+    typedef pbuf_pointer mark_type;
+
+    // works with or without FEATURE_EMBR_PBUF_CHAIN_EXP, unlike reset
+    mark_type mark() const { return p; }
+    void restore(mark_type m) { p = m; }
+
 
     // DEBUG ONLY
     // counts number of active chains
@@ -260,4 +266,22 @@ public:
     }
 };
 
+}
+
+namespace mem {
+
+template <>
+struct NetBufTraits<lwip::PbufNetbuf>
+{
+    static CONSTEXPR bool can_chain() { return true; }
+#ifdef FEATURE_EMBR_PBUF_CHAIN_EXP
+    static CONSTEXPR bool can_expand() { return true; }
+    static CONSTEXPR bool can_reset() { return true; }
+#else
+    static CONSTEXPR bool can_expand() { return false; }
+    // without p_start there's no getting back to head of chain
+    static CONSTEXPR bool can_reset() { return false; }
+#endif
+};
+
 }}
\ No newline at end of file
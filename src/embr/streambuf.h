@@ -3,21 +3,205 @@
 #include <estd/streambuf.h>
 #include <estd/optional.h>
 
+#include <string.h>
+
 #include "netbuf.h"
+#include "internal/endian.h"
 
 // At time of writing, FEATURE_ESTD_IOSTREAM_STRICT_CONST is invented.  It's more experimental, since it's not
 // fully functional.  The idea is that additional const-ness than stock std performs for the pbase, pptr, etc.
 // could be useful.  This may have additional consequence when we get into more advanced memory buffers which
 // can't be const'd up as much (virtual memory, etc - any memory which has side effects when utilizing it)
 
+// how many chunks a chained netbuf streambuf remembers the whereabouts of, so that seeking
+// backward need not walk from the start of the chain
+#ifndef EMBR_STREAMBUF_SEEK_INDEX_SIZE
+#define EMBR_STREAMBUF_SEEK_INDEX_SIZE 8
+#endif
+
 namespace embr { namespace mem {
 
 namespace impl {
 
+// default digest policy: tracks nothing, costs nothing
+struct null_digest
+{
+    void update(const void*, size_t) {}
+    void reset() {}
+};
+
+// holds the running digest (checksum, CRC, etc) of bytes put through xsputn.
+// TDigest is anything with update(const void*, size_t) - see embr/checksum.h
+template <class TDigest>
+struct netbuf_streambuf_digest_base
+{
+    typedef TDigest digest_type;
+
+    TDigest m_digest;
+
+    TDigest& digest() { return m_digest; }
+    const TDigest& digest() const { return m_digest; }
+};
+
+// specialized so that the null digest occupies no space at all
+template <>
+struct netbuf_streambuf_digest_base<null_digest>
+{
+    typedef null_digest digest_type;
+
+    static null_digest digest() { return null_digest(); }
+};
+
+// tracks absolute offset of the current chunk's first byte within the whole chain
+template <class TSize, bool contiguous>
+struct netbuf_streambuf_offset_base
+{
+    TSize m_chunk_offset;
+
+    netbuf_streambuf_offset_base() : m_chunk_offset(0) {}
+
+    TSize chunk_offset() const { return m_chunk_offset; }
+    void chunk_offset(TSize offset) { m_chunk_offset = offset; }
+};
+
+// a netbuf which never chains is always at offset 0, so nothing to track
+template <class TSize>
+struct netbuf_streambuf_offset_base<TSize, true>
+{
+    static CONSTEXPR TSize chunk_offset() { return 0; }
+    void chunk_offset(TSize) {}
+};
+
+// where in the chain a chunk is, so as to return there without walking from the start
+template <class TMark, class TSize>
+struct netbuf_chunk_mark
+{
+    TMark mark;
+    TSize offset;
+};
+
+// offset -> chunk index, built lazily as chunks are departed going forward.  Offsets ascend.
+// When full, every other entry is dropped so the index keeps spanning the whole chain seen
+// so far, just more coarsely.  The first entry (offset 0) always survives
+template <class TMark, class TSize, bool contiguous>
+struct netbuf_streambuf_seek_index
+{
+    typedef netbuf_chunk_mark<TMark, TSize> entry_type;
+
+    entry_type m_entries[EMBR_STREAMBUF_SEEK_INDEX_SIZE];
+    unsigned m_count;
+
+    netbuf_streambuf_seek_index() : m_count(0) {}
+
+    void record(const entry_type& m)
+    {
+        if(m_count > 0 && m.offset <= m_entries[m_count - 1].offset) return;
+
+        if(m_count == EMBR_STREAMBUF_SEEK_INDEX_SIZE)
+        {
+            unsigned kept = 1;
+
+            for(unsigned i = 2; i < m_count; i += 2)
+                m_entries[kept++] = m_entries[i];
+
+            m_count = kept;
+
+            if(m_count == EMBR_STREAMBUF_SEEK_INDEX_SIZE) return;
+        }
+
+        m_entries[m_count++] = m;
+    }
+
+    // last chunk starting before 'p', or the very first chunk when 'p' is 0.  O(log n)
+    // null if no such chunk has been seen
+    const entry_type* find(TSize p) const
+    {
+        unsigned lo = 0, hi = m_count;
+
+        // first entry whose offset is >= p
+        while(lo < hi)
+        {
+            unsigned mid = (lo + hi) / 2;
+
+            if(m_entries[mid].offset < p)
+                lo = mid + 1;
+            else
+                hi = mid;
+        }
+
+        if(lo > 0) return &m_entries[lo - 1];
+
+        if(m_count > 0 && m_entries[0].offset == p) return &m_entries[0];
+
+        return NULLPTR;
+    }
+
+    // forget chunks starting beyond 'offset', i.e. ones a shrink may have freed
+    void truncate(TSize offset)
+    {
+        while(m_count > 0 && m_entries[m_count - 1].offset > offset) --m_count;
+    }
+};
+
+// a netbuf which never chains has only the one chunk to seek within
+template <class TMark, class TSize>
+struct netbuf_streambuf_seek_index<TMark, TSize, true>
+{
+    typedef netbuf_chunk_mark<TMark, TSize> entry_type;
+
+    void record(const entry_type&) {}
+    static const entry_type* find(TSize) { return NULLPTR; }
+    void truncate(TSize) {}
+};
+
+// remembers how much reserve() grew an expand-in-place netbuf by, so that commit() can
+// hand back whatever the caller didn't use.  Otherwise the netbuf's size - which for such
+// netbufs is the size of the payload - would count bytes never written
+template <class TSize, bool in_place>
+struct netbuf_streambuf_reserve_base
+{
+    TSize m_reserved_tail;
+
+    netbuf_streambuf_reserve_base() : m_reserved_tail(0) {}
+
+    void reserved(TSize grown_by) { m_reserved_tail += grown_by; }
+
+    // shrinks netbuf back down to 'end', but never below what it was before reserve() grew it
+    template <class TNetbuf>
+    void committed(TNetbuf& netbuf, TSize end)
+    {
+        if(m_reserved_tail == 0) return;
+
+        TSize sz = netbuf.size();
+        TSize keep = sz - m_reserved_tail;
+
+        if(keep < end) keep = end;
+        if(keep < sz) netbuf.shrink_experimental(keep);
+
+        m_reserved_tail = 0;
+    }
+};
+
+// chained netbufs move on to a fresh chunk rather than grow, leaving nothing to give back
+template <class TSize>
+struct netbuf_streambuf_reserve_base<TSize, false>
+{
+    void reserved(TSize) {}
+
+    template <class TNetbuf>
+    void committed(TNetbuf&, TSize) {}
+};
+
 // TODO: move the pos_streambuf_base to instead be double-inherited from the other in/out so we can
 // use in_pos_streambuf base etc
-template <class TNetbuf, class CharTraits>
-struct netbuf_streambuf_base
+// NOTE: chunk_offset() tracking assumes the netbuf is positioned at its beginning when handed
+// to us, and that only this streambuf moves it through its chain from then on
+template <class TNetbuf, class CharTraits, class TDigest = null_digest>
+struct netbuf_streambuf_base :
+    netbuf_streambuf_digest_base<TDigest>,
+    netbuf_streambuf_offset_base<
+        typename estd::remove_reference<TNetbuf>::type::size_type,
+        internal::netbuf_is_contiguous<typename estd::remove_reference<TNetbuf>::type>::value>
 {
     typedef CharTraits traits_type;
     typedef typename traits_type::char_type char_type;
@@ -25,9 +209,22 @@ struct netbuf_streambuf_base
     typedef typename estd::remove_reference<TNetbuf>::type netbuf_type;
     typedef typename netbuf_type::size_type size_type;
     typedef estd::streamsize streamsize;
+    typedef netbuf_streambuf_offset_base<size_type,
+        internal::netbuf_is_contiguous<netbuf_type>::value> offset_base_type;
+    typedef netbuf_streambuf_seek_index<typename netbuf_type::mark_type, size_type,
+        internal::netbuf_is_contiguous<netbuf_type>::value> seek_index_type;
+    typedef typename seek_index_type::entry_type chunk_mark;
 
     TNetbuf netbuf;
 
+protected:
+    seek_index_type seek_index;
+
+public:
+
+    // absolute position of current chunk's first byte.  O(1)
+    size_type chunk_offset() const { return offset_base_type::chunk_offset(); }
+
 #ifdef FEATURE_ESTD_IOSTREAM_STRICT_CONST
     char_type* data() { return static_cast<char_type*>(netbuf.data()); }
     const char_type* data() const { return static_cast<const char_type*>(netbuf.data()); }
@@ -50,37 +247,99 @@ struct netbuf_streambuf_base
 #endif
 
 protected:
-    // resets netbuf and then repositions back to the current chunk/chain pos
-    // counting how far in the current chunk/chain represents in absolute pos
-    pos_type absolute_finder()
+    void chunk_offset(size_type offset) { offset_base_type::chunk_offset(offset); }
+
+    // Move forward to next chunk, keeping chunk_offset() in step.  Always
+    // use this rather than netbuf.next() directly
+    bool next_chunk()
+    {
+        size_type sz = size();
+        chunk_mark departing = mark_chunk();
+
+        if(!netbuf.next()) return false;
+
+        seek_index.record(departing);
+        chunk_offset(chunk_offset() + sz);
+
+        return true;
+    }
+
+    // Move back to first chunk, keeping chunk_offset() in step
+    void reset_chunk()
     {
-        pos_type position = 0;
-        char_type* current = data();
         netbuf.reset();
+        chunk_offset(0);
+    }
 
-        while(current != data())
+    chunk_mark mark_chunk() const
+    {
+        chunk_mark m = { netbuf.mark(), chunk_offset() };
+        return m;
+    }
+
+    void restore_chunk(const chunk_mark& m)
+    {
+        netbuf.restore(m.mark);
+        chunk_offset(m.offset);
+    }
+
+    // expand with auto advance, keeping chunk_offset() in step if a new chunk was linked in
+    ExpandResult expand_chunk(size_type by_amount)
+    {
+        size_type sz = size();
+        chunk_mark departing = mark_chunk();
+        ExpandResult result = netbuf.expand(by_amount, true);
+
+        if(result == ExpandOKChained || result == ExpandWarnChained)
         {
-            position += size();
-            netbuf.next();
+            seek_index.record(departing);
+            chunk_offset(chunk_offset() + sz);
         }
 
-        return position;
+        return result;
+    }
+
+    // absolute pos of current chunk.  Formerly this reset and re-walked the chain,
+    // now it's tracked as we go
+    pos_type absolute_finder() const
+    {
+        return chunk_offset();
     }
 
-    pos_type seekoffhelper(pos_type new_pos)
+    // absolute position of end of chain.  Walks to last chunk
+    size_type end_chunk()
     {
-        bool has_next = true;
+        while(next_chunk()) {}
+
+        return chunk_offset() + size();
+    }
 
-        // FIX: handle pos past end somehow
-        while(new_pos > size() && has_next)
+    // moves to the chunk holding absolute position 'p'.  A 'p' landing exactly on the end
+    // of a chunk stays with that chunk - underflow/xsputn already know to move on from there.
+    // O(1) when 'p' is in current chunk.  Further ahead, walks forward from current chunk.
+    // Behind, jumps via seek_index to the nearest chunk already visited before 'p' - O(log n) -
+    // then walks forward only as far as the index has thinned out.  Every chunk behind us was
+    // departed through next_chunk/expand_chunk, so this works even for netbufs which can't reset
+    // returns false if 'p' is past end of chain, in which case we're left on last chunk, or
+    // if 'p' is behind current chunk with nowhere to jump back to, in which case we don't move
+    bool seek_chunk(size_type p)
+    {
+        if(p < chunk_offset())
         {
-            size_type sz = size();
-            has_next = netbuf.next();
+            const chunk_mark* m = seek_index.find(p);
 
-            new_pos -= sz;
+            if(m != NULLPTR)
+                restore_chunk(*m);
+            else if(NetBufTraits<netbuf_type>::can_reset())
+                reset_chunk();
+            else
+                return false;
         }
 
-        return new_pos;
+        while(p > chunk_offset() + size())
+            if(!next_chunk()) return false;
+
+        return true;
     }
 
 public:
@@ -100,7 +359,10 @@ template <class TNetbuf,
           class TBase = netbuf_streambuf_base<TNetbuf, CharTraits> >
 struct out_netbuf_streambuf : 
     estd::internal::impl::out_pos_streambuf_base<CharTraits>,
-    TBase
+    TBase,
+    netbuf_streambuf_reserve_base<
+        typename estd::remove_reference<TNetbuf>::type::size_type,
+        internal::netbuf_expands_in_place<typename estd::remove_reference<TNetbuf>::type>::value>
 {
     typedef TBase base_type;
     typedef estd::internal::impl::out_pos_streambuf_base<CharTraits> out_pos_base_type;
@@ -109,6 +371,8 @@ struct out_netbuf_streambuf :
     typedef typename estd::remove_reference<TNetbuf>::type netbuf_type;
     typedef const netbuf_type& const_netbuf_reference;
     typedef typename netbuf_type::size_type size_type;
+    typedef netbuf_streambuf_reserve_base<size_type,
+        internal::netbuf_expands_in_place<netbuf_type>::value> reserve_base_type;
     typedef typename traits_type::int_type int_type;
     typedef typename traits_type::off_type off_type;
     typedef typename traits_type::pos_type pos_type;
@@ -134,25 +398,10 @@ public:
         return absolute_pos + pos();
     }
 
-    // stateless flavor of total_size - depends on pos() being at the 'end'
-    // (i.e. performing a seekoff beforehand will create undefined results)
+    // absolute put position across the whole chain.  O(1)
     size_type absolute_pos() const
     {
-        const netbuf_type& nb = netbuf();
-
-        // TODO: wrap this in a strict/diagnostic #ifdef
-        // if we're not on the last netbuf chain when inquiring absolute_pos,
-        // undefined/unhandled
-        if(!nb.last()) return -1;
-
-        size_type total_size = nb.total_size();
-
-        // take cream off the top which is the total position - size of current pbuf/netbuf chunk
-        total_size -= nb.size();
-        // now, re-add where our streambuf-managed position is to get true 'processed' size
-        total_size += pos();
-
-        return total_size;
+        return base_type::chunk_offset() + pos();
     }
 
 private:
@@ -170,47 +419,60 @@ private:
 protected:
     void pos(size_type p) { out_pos_base_type::pos(p); }
 
+    typedef typename base_type::chunk_mark chunk_mark;
+
+    // absolute positioning common to seekoff and seekpos.  On failure, goes back to
+    // chunk 'from' and absolute position 'here' within it
+    pos_type seekabs(off_type p, size_type here, const chunk_mark& from)
+    {
+        if(p < 0 || !base_type::seek_chunk(p))
+        {
+            base_type::restore_chunk(from);
+            pos(here - base_type::chunk_offset());
+            return pos_type(off_type(-1));
+        }
+
+        pos(p - base_type::chunk_offset());
+
+        return pos_type(p);
+    }
+
     pos_type seekoff(off_type off, ios_base::seekdir way, ios_base::openmode which)
     {
-        if(!(which & ios_base::out)) return -1;
+        if(!(which & ios_base::out)) return pos_type(off_type(-1));
+
+        size_type here = absolute_pos();
+        const chunk_mark from = base_type::mark_chunk();
 
         switch(way)
         {
             case ios_base::beg:
-                netbuf().reset();
-                if(off < size())
-                    this->pbump(off);
-                else
-                {
-                    pos(base_type::seekoffhelper(off));
-                }
-                break;
+                return seekabs(off, here, from);
 
             case ios_base::cur:
-                // TODO: Check for negative, positive or 0 value
-                if(off == 0)
-                {
-                    // not positioning anywhere, just a kind of helper for tellp()
-                    // NOTE: unsure if absolute pos is a good precedent here
-                    return absolute_pos();
-                }
-                else if(off + pos() < size())
-                    this->pbump(off);
-                else
-                {
-                    pos(base_type::seekoffhelper(off + pos()));
-                }
-                break;
+                // not positioning anywhere, just a kind of helper for tellp()
+                if(off == 0) return here;
+
+                return seekabs(off_type(here) + off, here, from);
 
             case ios_base::end:
-                // UNTESTED
-                while(netbuf().next()) {}
-                pos(size() + off);
-                break;
+            {
+                // end_chunk() moves us, hence 'from' having been taken beforehand
+                off_type end = base_type::end_chunk();
+
+                return seekabs(end + off, here, from);
+            }
+
+            default:
+                return pos_type(off_type(-1));
         }
+    }
 
-        // FIX: not adequate, need to compensate for movement over netbuf chains
-        return pos();
+    pos_type seekpos(pos_type p, ios_base::openmode which)
+    {
+        if(!(which & ios_base::out)) return pos_type(off_type(-1));
+
+        return seekabs(off_type(p), absolute_pos(), base_type::mark_chunk());
     }
 
 
@@ -260,6 +522,9 @@ public:
 
     // NOTE: Duplicated code from elsewhere.  Annoying, but expected
     // since this is the first time I've put it in a truly standard place
+    // NOTE: digest() sees bytes in the order they're put here.  Seeking backwards
+    // and overwriting is not reflected in it, so in that case reset() the digest
+    // and run it over the finished netbuf instead
     streamsize xsputn(const char_type* s, streamsize count)
     {
         char_type* d = pptr();
@@ -271,19 +536,16 @@ public:
         {
             // put in as much as we can
             count -= remaining;
+            base_type::digest().update(s, remaining * sizeof(char_type));
             while(remaining--) *d++ = *s++;
 
             // move to next netbuf.data()
-            bool has_next = netbuf().next();
-
-            // whether or not has_next succeeds, pos is reset here
-            // this means if it fails, the next write operation will overwrite the contents
-            // so keep an eye on your return streamsize
-            pos(0);
+            bool has_next = base_type::next_chunk();
 
             if(has_next)
             {
                 // if there's another netbuf.data() for us to move to, get specs for it
+                pos(0);
                 remaining = size();
                 d = data();
             }
@@ -291,17 +553,19 @@ public:
             {
                 // try to expand.  Not all netbufs can or will
                 // also auto advance to next buffer
-                switch(netbuf().expand(count, true))
+                switch(base_type::expand_chunk(count))
                 {
                     case ExpandResult::ExpandOKChained:
+                        pos(0);
                         remaining = size();
                         d = data();
                         break;
 
                     default:
-                        // NOTE: pos is left in an invalid state here
-                        // otherwise, we aren't able to write everything so return what we
-                        // could do
+                        // we aren't able to write everything so return what we
+                        // could do.  pos stays at end of this chunk, so absolute_pos()
+                        // remains accurate
+                        pos(size());
                         return orig_count - count;
                 }
             }
@@ -309,17 +573,123 @@ public:
 
         this->pbump(count);
 
+        base_type::digest().update(s, count * sizeof(char_type));
         while(count--) *d++ = *s++;
 
         return orig_count;
     }
 
+    ///
+    /// \brief zero copy write: at least n contiguous writable bytes at pptr()
+    ///
+    /// Moves on to the next chunk, or expands, if current chunk can't hold n.  Write into
+    /// the returned span, then commit() however many characters were actually used.
+    /// Empty if n contiguous characters can't be had.  Notably, a chained netbuf whose current
+    /// chunk is partly filled yields empty even if the next chunk could hold n, since moving on
+    /// would leave the rest of this chunk as a hole amidst the data.  Fall back to sputn then,
+    /// which fills out this chunk first - once it's full, reserve moves on as usual
+    ///
+    estd::span<char_type> reserve(size_type n)
+    {
+        size_type remaining = size() - pos();
+
+        if(n > remaining)
+        {
+            if(remaining == 0)
+            {
+                if(base_type::next_chunk())
+                    pos(0);
+                else
+                {
+                    switch(base_type::expand_chunk(n))
+                    {
+                        case ExpandResult::ExpandOKChained:
+                            pos(0);
+                            break;
+
+                        case ExpandResult::ExpandOKLinear:
+                            reserve_base_type::reserved(n);
+                            break;
+
+                        default:
+                            return estd::span<char_type>(NULLPTR, 0);
+                    }
+                }
+            }
+            // linear netbufs can grow current chunk in place
+            else if(!NetBufTraits<netbuf_type>::can_chain())
+            {
+                if(netbuf().expand(n - remaining, false) != ExpandResult::ExpandOKLinear)
+                    return estd::span<char_type>(NULLPTR, 0);
+
+                reserve_base_type::reserved(n - remaining);
+            }
+            else
+                return estd::span<char_type>(NULLPTR, 0);
+
+            remaining = size() - pos();
+
+            if(n > remaining) return estd::span<char_type>(NULLPTR, 0);
+        }
+
+        return estd::span<char_type>(pptr(), remaining);
+    }
+
+    // marks k characters of reserve()'d space as written.  k is clamped to what's left
+    // of current chunk, so that pptr() never passes epptr().  An expand-in-place netbuf
+    // which reserve() grew is shrunk back down past the last committed character
+    // \return number of characters actually committed
+    size_type commit(size_type k)
+    {
+        size_type remaining = size() - pos();
+
+        if(k > remaining) k = remaining;
+
+        base_type::digest().update(pptr(), k * sizeof(char_type));
+        this->pbump(k);
+
+        reserve_base_type::committed(netbuf(), pos());
+
+        return k;
+    }
+
+    ///
+    /// \brief writes network order unsigned integer
+    ///
+    /// Single unaligned store when it fits in current chunk, otherwise bytes are split
+    /// across chunk boundary via xsputn
+    /// \return false if netbuf couldn't hold all of value
+    ///
+    template <class TUInt>
+    bool write_big_endian(TUInt value)
+    {
+        if(size() - pos() >= (size_type)sizeof(TUInt))
+        {
+            embr::internal::store_big_endian(pptr(), value);
+            base_type::digest().update(pptr(), sizeof(TUInt));
+            this->pbump(sizeof(TUInt) / sizeof(char_type));
+            return true;
+        }
+
+        uint8_t bytes[sizeof(TUInt)];
+
+        embr::internal::store_big_endian(bytes, value);
+
+        return xsputn(reinterpret_cast<const char_type*>(bytes), sizeof(bytes)) ==
+            (streamsize)sizeof(bytes);
+    }
+
+    bool write_u16(uint16_t value) { return write_big_endian(value); }
+    bool write_u32(uint32_t value) { return write_big_endian(value); }
+    bool write_u64(uint64_t value) { return write_big_endian(value); }
+
     // This flavor in theory can shrink no matter where 'pos' is, but in reality it depends on
     // pos being at the end, so is no better than 'experimental2' variety.  Keeping around
     // until experimentation is complete, just in case I'm wrong
     void shrink_to_fit_experimental()
     {
         netbuf().shrink(total_size_experimental());
+        base_type::seek_index.truncate(base_type::chunk_offset());
     }
 
     // This flavor is much more efficient, however it depends on 'pos' being positioned exactly
@@ -327,6 +697,7 @@ public:
     void shrink_to_fit_experimental2()
     {
         netbuf().shrink(absolute_pos());
+        base_type::seek_index.truncate(base_type::chunk_offset());
     }
 };
 
@@ -351,56 +722,159 @@ struct in_netbuf_streambuf :
 
     pos_type pos() const { return in_pos_base_type::pos(); }
 
+    // absolute get position across the whole chain.  O(1)
+    size_type absolute_pos() const
+    {
+        return base_type::chunk_offset() + pos();
+    }
+
     const netbuf_type& netbuf() const { return base_type::netbuf; }
     netbuf_type& netbuf() { return base_type::netbuf; }
 
 private:
+    // true_type for netbufs which never chain, in which case reads reduce to plain
+    // pointer arithmetic
+    typedef internal::netbuf_is_contiguous<netbuf_type> contiguous_tag;
+
     char_type* data() const { return base_type::data(); }
     size_type size() const { return base_type::size(); }
 
     // end of particular chunk has been reached
     bool eol() const { return pos() == size(); }
 
+    int_type underflow(estd::true_type)
+    {
+        if(eol()) return traits_type::eof();
+
+        return traits_type::to_int_type(*gptr());
+    }
+
+    int_type underflow(estd::false_type)
+    {
+        if(eol())
+        {
+            // if we can't get anything more out of our netbuf
+            if(!base_type::next_chunk())
+                // return eof.  If netbuf can't provide us any further data, we're done
+                return traits_type::eof();
+
+            pos(0);
+        }
+
+        // otherwise, yank out current character (without advancing)
+        return traits_type::to_int_type(*gptr());
+    }
+
+    // no chain to walk, so one bounded copy does it
+    streamsize xsgetn(char_type* d, streamsize count, estd::true_type)
+    {
+        size_type remaining = size() - pos();
+
+        if(count > (streamsize)remaining) count = remaining;
+
+        memcpy(d, gptr(), count * sizeof(char_type));
+        this->gbump(count);
+
+        return count;
+    }
+
+    streamsize xsgetn(char_type* d, streamsize count, estd::false_type)
+    {
+        const char_type* s = gptr();
+        streamsize orig_count = count;
+        // remaining = number of bytes available to read out of this chunk
+        size_type remaining = size() - pos();
+
+        while(count > remaining)
+        {
+            count -= remaining;
+            d = estd::copy_n(s, remaining, d);
+
+            // NOTE: Consider 'underflow' here since count > remaining means we always have at least 1
+            // more character to read here
+            if(base_type::next_chunk())
+            {
+                pos(0);
+                s = data();
+                remaining = size();
+            }
+            else
+            {
+                // don't try to expand on a read, that would be invalid/synthetic input
+                // instead, just report how much we did succeed in reading (basically
+                // we are EOF).  pos stays at end of this chunk
+                pos(size());
+                return orig_count - count;
+            }
+        }
+
+        // we get here when count <= remaining, and don't need
+        // to issue a 'next'
+        this->gbump(count);
+
+        estd::copy_n(s, count, d);
+
+        return orig_count;
+    }
+
 protected:
     void pos(pos_type p) { in_pos_base_type::pos(p); }
 
+    typedef typename base_type::chunk_mark chunk_mark;
+
+    // absolute positioning common to seekoff and seekpos.  On failure, goes back to
+    // chunk 'from' and absolute position 'here' within it
     // TODO: Try to consolidate this into a netbuf_streambuf_base - impediment
     // is that that one doesn't implement the pos base
+    pos_type seekabs(off_type p, size_type here, const chunk_mark& from)
+    {
+        if(p < 0 || !base_type::seek_chunk(p))
+        {
+            base_type::restore_chunk(from);
+            pos(here - base_type::chunk_offset());
+            return pos_type(off_type(-1));
+        }
+
+        pos(p - base_type::chunk_offset());
+
+        return pos_type(p);
+    }
+
     pos_type seekoff(off_type off, ios_base::seekdir way, ios_base::openmode which)
     {
-        // openmode MUST include 'out' in this instance, otherwise error or ignore
-        if(!(which & ios_base::in)) return -1;
+        if(!(which & ios_base::in)) return pos_type(off_type(-1));
+
+        size_type here = absolute_pos();
+        const chunk_mark from = base_type::mark_chunk();
 
         switch(way)
         {
+            case ios_base::beg:
+                return seekabs(off, here, from);
+
             case ios_base::cur:
-                if(off + pos() < size())
-                    this->gbump(off);
-                else
-                {
-                    pos(base_type::seekoffhelper(off + pos()));
-                }
-                break;
+                if(off == 0) return here;
 
-            case ios_base::beg:
-                netbuf().reset();
-                if(off < size())
-                    pos(off);
-                else
-                {
-                    pos(base_type::seekoffhelper(off));
-                }
-                break;
+                return seekabs(off_type(here) + off, here, from);
 
             case ios_base::end:
-                // UNTESTED
-                while(netbuf().next()) {}
-                pos(size() + off);
-                break;
+            {
+                // end_chunk() moves us, hence 'from' having been taken beforehand
+                off_type end = base_type::end_chunk();
+
+                return seekabs(end + off, here, from);
+            }
+
+            default:
+                return pos_type(off_type(-1));
         }
+    }
+
+    pos_type seekpos(pos_type p, ios_base::openmode which)
+    {
+        if(!(which & ios_base::in)) return pos_type(off_type(-1));
 
-        // TODO: after doing above legwork, this pos() will be more complex
-        return pos();
+        return seekabs(off_type(p), absolute_pos(), base_type::mark_chunk());
     }
 
     // remember, 'underflow' does not advance character forward and only moves
@@ -408,18 +882,7 @@ protected:
     // Interesting.... I rewrote sgetc...
     int_type underflow()
     {
-        if(eol())
-        {
-            // if we can't get anything more out of our netbuf
-            if(!netbuf().next())
-                // return eof.  If netbuf can't provide us any further data, we're done
-                return traits_type::eof();
-
-            pos(0);
-        }
-
-        // otherwise, yank out current character (without advancing)
-        return traits_type::to_int_type(*gptr());
+        return underflow(contiguous_tag());
     }
 
 public:
@@ -485,49 +948,105 @@ public:
 
     streamsize xsgetn(char_type* d, streamsize count)
     {
-        const char_type* s = gptr();
-        streamsize orig_count = count;
-        // remaining = number of bytes available to read out of this chunk
+        return xsgetn(d, count, contiguous_tag());
+    }
+
+    ///
+    /// \brief zero copy read: span of at least min characters starting at gptr()
+    ///
+    /// Common case points right into the current chunk.  When the field straddles a chunk
+    /// boundary, min characters are instead gathered into caller's bounce buffer.  That
+    /// costs a copy, so is best kept to the uncommon case.  Either way nothing is consumed -
+    /// follow up with consume()
+    ///
+    /// \return empty span if fewer than min characters remain, or if bounce is needed but
+    /// smaller than min
+    ///
+    estd::span<char_type> peek_contiguous(size_type min, estd::span<char_type> bounce)
+    {
         size_type remaining = size() - pos();
 
-        while(count > remaining)
+        // nothing lost by moving past an exhausted chunk
+        while(remaining == 0 && base_type::next_chunk())
         {
-            count -= remaining;
-            d = estd::copy_n(s, remaining, d);
-
             pos(0);
+            remaining = size();
+        }
 
-            // NOTE: Consider 'underflow' here since count > remaining means we always have at least 1
-            // more character to read here
-            if(netbuf().next())
-            {
-                s = data();
-                remaining = size();
-            }
-            else
-            {
-                // don't try to expand on a read, that would be invalid/synthetic input
-                // instead, just report how much we did succeed in reading (basically
-                // we are EOF)
-                return orig_count - count;
-            }
+        if(remaining >= min) return estd::span<char_type>(gptr(), remaining);
+
+        if(bounce.size() < (size_t)min) return estd::span<char_type>(NULLPTR, 0);
+
+        // xsgetn walks us forward, so come straight back to this chunk afterward.  Seeking
+        // would mean walking from the start of the chain, which not all netbufs can do
+        const chunk_mark from = base_type::mark_chunk();
+        const size_type here = pos();
+        streamsize read = xsgetn(bounce.data(), min);
+
+        base_type::restore_chunk(from);
+        pos(here);
+
+        if(read < (streamsize)min) return estd::span<char_type>(NULLPTR, 0);
+
+        return estd::span<char_type>(bounce.data(), min);
+    }
+
+    // flavor without a bounce buffer, empty span when min straddles chunks
+    estd::span<char_type> peek_contiguous(size_type min)
+    {
+        return peek_contiguous(min, estd::span<char_type>(NULLPTR, 0));
+    }
+
+    // advances past k characters, typically following peek_contiguous()
+    // \return false, without moving, if fewer than k characters remain
+    bool consume(size_type k)
+    {
+        if(k <= size() - pos())
+        {
+            this->gbump(k);
+            return true;
         }
 
-        // we get here when count <= remaining, and don't need
-        // to issue a 'next'
-        this->gbump(count);
+        size_type here = absolute_pos();
 
-        estd::copy_n(s, count, d);
+        return seekabs(here + k, here, base_type::mark_chunk()) != pos_type(off_type(-1));
+    }
 
-        return orig_count;
+    ///
+    /// \brief reads network order unsigned integer
+    ///
+    /// Single unaligned load when value lies entirely in current chunk, otherwise bytes are
+    /// stitched together across chunk boundary via xsgetn
+    /// \return false if chain ended first, in which case whatever was present is consumed
+    ///
+    template <class TUInt>
+    bool read_big_endian(TUInt& value)
+    {
+        if(size() - pos() >= (size_type)sizeof(TUInt))
+        {
+            value = embr::internal::load_big_endian<TUInt>(gptr());
+            this->gbump(sizeof(TUInt) / sizeof(char_type));
+            return true;
+        }
+
+        uint8_t bytes[sizeof(TUInt)];
+
+        if(xsgetn(reinterpret_cast<char_type*>(bytes), sizeof(bytes)) != (streamsize)sizeof(bytes))
+            return false;
+
+        value = embr::internal::load_big_endian<TUInt>(bytes);
+        return true;
     }
 
+    bool read_u16(uint16_t& value) { return read_big_endian(value); }
+    bool read_u32(uint32_t& value) { return read_big_endian(value); }
+    bool read_u64(uint64_t& value) { return read_big_endian(value); }
+
+    // NOTE: relies on total_size() reporting the whole chain, which for PbufNetbuf
+    // means FEATURE_EMBR_PBUF_CHAIN_EXP
     streamsize showmanyc()
     {
-        // FIX: What we'll need to do for showmanyc in a netbuf is:
-        // a) know what our meta-position is, across chained netbufs
-        // b) subtract *that* from total_size()
-        return netbuf().total_size() - pos();
+        return netbuf().total_size() - absolute_pos();
     }
 };
 
@@ -535,8 +1054,11 @@ public:
 }
 
 #ifdef FEATURE_CPP_ALIASTEMPLATE
-template <class CharT, class TNetbuf, class CharTraits = std::char_traits<CharT> >
-using out_netbuf_streambuf = estd::internal::streambuf<impl::out_netbuf_streambuf<TNetbuf, CharTraits> >;
+// TDigest keeps a running checksum/CRC of everything written, available via digest()
+template <class CharT, class TNetbuf, class CharTraits = std::char_traits<CharT>,
+          class TDigest = impl::null_digest>
+using out_netbuf_streambuf = estd::internal::streambuf<impl::out_netbuf_streambuf<TNetbuf, CharTraits,
+    impl::netbuf_streambuf_base<TNetbuf, CharTraits, TDigest> > >;
 
 template <class CharT, class TNetbuf, class CharTraits = std::char_traits<CharT> >
 using in_netbuf_streambuf = estd::internal::streambuf<impl::in_netbuf_streambuf<TNetbuf, CharTraits> >;
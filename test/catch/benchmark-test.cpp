@@ -0,0 +1,459 @@
+// Timing comparisons.  Hidden by default, run with:
+//      embr-unit-test [.benchmark]
+// Figures are reported via WARN rather than asserted, since they depend on the
+// machine and build flags
+#include <catch.hpp>
+
+#include <embr/checksum.h>
+#include <embr/streambuf.h>
+#include <embr/netbuf-static.h>
+#include <embr/netbuf-dynamic.h>
+#include <embr/netbuf-writer.h>
+#include <embr/format.h>
+#include <embr/datapump.hpp>
+#include <embr/datapump-queue.h>
+#include <embr/transport-descriptor.h>
+#include <embr/exp/retry-v2.h>
+
+#include <algorithm>
+#include <chrono>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <vector>
+
+#include <stdio.h>
+
+using namespace embr;
+
+namespace {
+
+typedef std::chrono::steady_clock clock_type;
+typedef mem::experimental::NetBufDynamic<> chain_type;
+
+// typical ethernet MSS sized chunks
+void fill_chain(chain_type& nb, size_t total, size_t chunk_size)
+{
+    uint8_t value = 0;
+
+    while(total > 0)
+    {
+        size_t sz = chunk_size < total ? chunk_size : total;
+
+        nb.expand(sz, true);
+
+        uint8_t* p = static_cast<uint8_t*>(nb.data());
+
+        for(size_t i = 0; i < sz; i++) p[i] = value++ * 7;
+
+        total -= sz;
+    }
+
+    nb.reset();
+}
+
+template <class F>
+double ns_per_byte(F f, size_t bytes, int iterations)
+{
+    clock_type::time_point start = clock_type::now();
+
+    for(int i = 0; i < iterations; i++) f();
+
+    std::chrono::duration<double, std::nano> elapsed = clock_type::now() - start;
+
+    return elapsed.count() / ((double)bytes * iterations);
+}
+
+void report(const char* name, double ns)
+{
+    std::ostringstream s;
+
+    s << name << ": " << ns << " ns/byte (" << (1000.0 / ns) << " MB/s)";
+
+    WARN(s.str());
+}
+
+void report_per_value(const char* name, double ns)
+{
+    std::ostringstream s;
+
+    s << name << ": " << ns << " ns/value";
+
+    WARN(s.str());
+}
+
+void report_rate(const char* name, int n, double items_per_sec)
+{
+    std::ostringstream s;
+
+    s << name << " " << n << ": " << items_per_sec << " items/sec";
+
+    WARN(s.str());
+}
+
+// how an application does it without chain aware kernels: pulling each byte
+// back out through the streambuf
+template <class TDigest>
+uint32_t sbumpc_digest(chain_type& nb)
+{
+    typedef mem::in_netbuf_streambuf<char, chain_type&> streambuf_type;
+    typedef streambuf_type::traits_type traits_type;
+
+    nb.reset();
+
+    streambuf_type sb(nb);
+    TDigest d;
+    streambuf_type::int_type ch;
+
+    while((ch = sb.sbumpc()) != traits_type::eof())
+    {
+        uint8_t c = (uint8_t)ch;
+        d.update(&c, 1);
+    }
+
+    return d.value();
+}
+
+typedef experimental::BasicRetry<const char*, int> bench_retry_impl;
+typedef bench_retry_impl::RetryItem bench_retry_item;
+
+// average ns per item to add, cancel and expire n outstanding retries
+template <class TRetry>
+void retry_scheduler(const char* name, int n)
+{
+    std::vector<bench_retry_item> items(n);
+    std::vector<int> order(n);
+    std::mt19937 r(0);
+    TRetry retry;
+    clock_type::time_point now = clock_type::now();
+
+    for(int i = 0; i < n; i++)
+    {
+        // spread over a couple of seconds, as a burst of CON messages would be
+        items[i]._due = now + std::chrono::milliseconds(r() % 2000);
+        order[i] = i;
+    }
+
+    std::shuffle(order.begin(), order.end(), r);
+
+    clock_type::time_point start = clock_type::now();
+
+    for(int i = 0; i < n; i++) retry.add_to_retry(&items[i]);
+
+    clock_type::time_point added = clock_type::now();
+
+    for(int i = 0; i < n; i++) retry.remove_from_retry(&items[order[i]]);
+
+    clock_type::time_point cancelled = clock_type::now();
+
+    for(int i = 0; i < n; i++)
+    {
+        items[i]._due -= std::chrono::milliseconds(2000);
+        retry.add_to_retry(&items[i]);
+    }
+
+    clock_type::time_point readded = clock_type::now();
+
+    int expired = 0;
+
+    while(retry.dequeue_retry_ready() != NULLPTR) expired++;
+
+    clock_type::time_point done = clock_type::now();
+
+    REQUIRE(expired == n);
+
+    std::chrono::duration<double, std::nano> add_ns = added - start;
+    std::chrono::duration<double, std::nano> cancel_ns = cancelled - added;
+    std::chrono::duration<double, std::nano> expire_ns = done - readded;
+    std::ostringstream s;
+
+    s << name << " " << n << ": add " << (add_ns.count() / n) <<
+        " ns, cancel " << (cancel_ns.count() / n) <<
+        " ns, expire " << (expire_ns.count() / n) << " ns per item";
+
+    WARN(s.str());
+}
+
+}
+
+TEST_CASE("benchmarks", "[.benchmark]")
+{
+    SECTION("checksum")
+    {
+        const size_t total = 64 * 1024;
+        const int iterations = 200;
+
+        chain_type nb;
+
+        fill_chain(nb, total, 1460);
+
+        // volatile so that optimizer can't discard results
+        volatile uint32_t sink;
+
+        double chain_inet = ns_per_byte([&]() { sink = experimental::internet_checksum(nb); },
+            total, iterations);
+        double chain_crc = ns_per_byte([&]() { sink = experimental::crc32(nb); },
+            total, iterations);
+        double chain_crcc = ns_per_byte([&]() { sink = experimental::crc32c(nb); },
+            total, iterations);
+        double bytewise_inet = ns_per_byte([&]() { sink = sbumpc_digest<experimental::InternetChecksum>(nb); },
+            total, iterations);
+        double bytewise_crc = ns_per_byte([&]() { sink = sbumpc_digest<experimental::Crc32Ieee>(nb); },
+            total, iterations);
+
+        (void)sink;
+
+        report("internet checksum (chain)", chain_inet);
+        report("internet checksum (sbumpc)", bytewise_inet);
+        report("crc32 (chain)", chain_crc);
+        report("crc32c (chain)", chain_crcc);
+        report("crc32 (sbumpc)", bytewise_crc);
+
+        // both approaches must of course agree
+        REQUIRE(experimental::internet_checksum(nb) ==
+                sbumpc_digest<experimental::InternetChecksum>(nb));
+        REQUIRE(experimental::crc32(nb) == sbumpc_digest<experimental::Crc32Ieee>(nb));
+    }
+    SECTION("contiguous sbumpc")
+    {
+        typedef mem::layer1::NetBuf<16384> netbuf_type;
+        typedef mem::in_netbuf_streambuf<char, netbuf_type&> streambuf_type;
+        typedef streambuf_type::traits_type traits_type;
+
+        const int iterations = 200;
+
+        netbuf_type nb;
+        uint8_t* p = static_cast<uint8_t*>(nb.data());
+
+        for(size_t i = 0; i < nb.size(); i++) p[i] = (uint8_t)i;
+
+        volatile uint32_t sink;
+
+        double raw = ns_per_byte([&]()
+        {
+            uint32_t sum = 0;
+            for(size_t i = 0; i < nb.size(); i++) sum += p[i];
+            sink = sum;
+        }, nb.size(), iterations);
+
+        double streambuf = ns_per_byte([&]()
+        {
+            streambuf_type sb(nb);
+            uint32_t sum = 0;
+            streambuf_type::int_type ch;
+
+            while((ch = sb.sbumpc()) != traits_type::eof()) sum += (uint8_t)ch;
+
+            sink = sum;
+        }, nb.size(), iterations);
+
+        (void)sink;
+
+        report("raw buffer loop", raw);
+        report("contiguous sbumpc loop", streambuf);
+    }
+    SECTION("formatting")
+    {
+        typedef mem::NetBufWriter<chain_type&> writer_type;
+
+        const int count = 10000;
+        const int iterations = 20;
+
+        std::mt19937_64 r(0);
+        std::vector<int> ints(count);
+        std::vector<double> doubles(count);
+
+        for(int i = 0; i < count; i++)
+        {
+            ints[i] = (int)(r() >> (r() % 64));
+            doubles[i] = (double)(int64_t)r() / (double)(r() | 1);
+        }
+
+        // what experimental::itoa used to do
+        double sprintf_int = ns_per_byte([&]()
+        {
+            chain_type nb;
+            writer_type w(nb);
+            char buf[32];
+
+            for(int i = 0; i < count; i++)
+                w.write(buf, sprintf(buf, "%d", ints[i]));
+        }, count, iterations);
+
+        double lut_int = ns_per_byte([&]()
+        {
+            chain_type nb;
+            writer_type w(nb);
+
+            for(int i = 0; i < count; i++)
+                experimental::write_decimal(w, ints[i]);
+        }, count, iterations);
+
+        // %.17g being what's needed for sprintf to round trip
+        double sprintf_double = ns_per_byte([&]()
+        {
+            chain_type nb;
+            writer_type w(nb);
+            char buf[32];
+
+            for(int i = 0; i < count; i++)
+                w.write(buf, sprintf(buf, "%.17g", doubles[i]));
+        }, count, iterations);
+
+        double grisu_double = ns_per_byte([&]()
+        {
+            chain_type nb;
+            writer_type w(nb);
+
+            for(int i = 0; i < count; i++)
+                experimental::write_decimal(w, doubles[i]);
+        }, count, iterations);
+
+        report_per_value("int (sprintf)", sprintf_int);
+        report_per_value("int (write_decimal)", lut_int);
+        report_per_value("double (sprintf %.17g)", sprintf_double);
+        report_per_value("double (write_decimal)", grisu_double);
+    }
+    SECTION("writer")
+    {
+        typedef mem::NetBufWriter<chain_type&> writer_type;
+        typedef mem::out_netbuf_streambuf<char, chain_type&> streambuf_type;
+
+        const size_t total = 64 * 1024;
+        const int iterations = 200;
+
+        std::vector<char> payload(total);
+
+        for(size_t i = 0; i < total; i++) payload[i] = (char)(i * 7);
+
+        const size_t piece_sizes[] = { 4, 64, 1460 };
+
+        for(size_t piece : piece_sizes)
+        {
+            double writer = ns_per_byte([&]()
+            {
+                chain_type nb;
+                writer_type w(nb);
+
+                for(size_t i = 0; i < total; i += piece)
+                    w.write(&payload[i], (int)std::min(piece, total - i));
+            }, total, iterations);
+
+            double xsputn = ns_per_byte([&]()
+            {
+                chain_type nb;
+                streambuf_type sb(nb);
+
+                for(size_t i = 0; i < total; i += piece)
+                    sb.xsputn(&payload[i], std::min(piece, total - i));
+            }, total, iterations);
+
+            std::ostringstream name;
+
+            name << "NetBufWriter::write, " << piece << " byte pieces";
+            report(name.str().c_str(), writer);
+
+            name.str("");
+            name << "xsputn, " << piece << " byte pieces";
+            report(name.str().c_str(), xsputn);
+        }
+
+        double writer_u32 = ns_per_byte([&]()
+        {
+            chain_type nb;
+            writer_type w(nb);
+
+            for(size_t i = 0; i < total; i += 4) w.write_u32((uint32_t)i);
+        }, total, iterations);
+
+        double xsputn_u32 = ns_per_byte([&]()
+        {
+            chain_type nb;
+            streambuf_type sb(nb);
+
+            for(size_t i = 0; i < total; i += 4) sb.write_u32((uint32_t)i);
+        }, total, iterations);
+
+        report("NetBufWriter::write_u32", writer_u32);
+        report("out_netbuf_streambuf::write_u32", xsputn_u32);
+
+        // and both produce the same bytes
+        chain_type nb_writer, nb_streambuf;
+        writer_type w(nb_writer);
+        streambuf_type sb(nb_streambuf);
+
+        for(size_t i = 0; i < total; i += 64)
+        {
+            w.write(&payload[i], 64);
+            sb.xsputn(&payload[i], 64);
+        }
+
+        REQUIRE(experimental::crc32(nb_writer) == experimental::crc32(nb_streambuf));
+    }
+    SECTION("mpmc datapump")
+    {
+        typedef mem::layer1::NetBuf<128> netbuf_type;
+        typedef TransportDescriptor<netbuf_type, int> transport_descriptor;
+        typedef DataPump<transport_descriptor, EmptyAppDataMpmcQueuePolicy<256> > datapump_type;
+        typedef datapump_type::Item item_type;
+
+        const int count = 200000;
+        unsigned max_consumers = std::thread::hardware_concurrency();
+
+        if(max_consumers < 4) max_consumers = 4;
+
+        for(unsigned consumers = 1; consumers <= max_consumers; consumers++)
+        {
+            datapump_type datapump;
+            std::atomic<int> processed(0);
+            std::atomic<uint32_t> sink(0);
+            std::vector<std::thread> threads;
+
+            clock_type::time_point start = clock_type::now();
+
+            for(unsigned t = 0; t < consumers; t++)
+                threads.emplace_back([&]()
+                {
+                    while(processed < count)
+                    {
+                        item_type* item = datapump.dequeue_claim();
+
+                        if(item == NULLPTR)
+                        {
+                            std::this_thread::yield();
+                            continue;
+                        }
+
+                        // stand in for application level processing
+                        sink += experimental::crc32(*item->netbuf());
+
+                        datapump.dequeue_release(item);
+                        processed++;
+                    }
+                });
+
+            for(int i = 0; i < count; i++)
+                datapump.transport_in(netbuf_type(), i);
+
+            for(std::thread& t : threads) t.join();
+
+            std::chrono::duration<double> elapsed = clock_type::now() - start;
+
+            report_rate("mpmc datapump, consumers", consumers, count / elapsed.count());
+        }
+    }
+    SECTION("retry scheduler")
+    {
+        typedef experimental::Retry2<const char*, int, bench_retry_impl> list_type;
+        typedef experimental::Retry2<const char*, int, bench_retry_impl, bench_retry_item,
+            experimental::RetryWheelPolicy<1024, 2> > wheel_type;
+
+        const int counts[] = { 10, 100, 10000 };
+
+        for(int n : counts)
+        {
+            retry_scheduler<list_type>("retry list", n);
+            retry_scheduler<wheel_type>("retry wheel", n);
+        }
+    }
+}
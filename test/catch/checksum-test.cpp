@@ -0,0 +1,161 @@
+#include <catch.hpp>
+
+#include <embr/checksum.h>
+#include <embr/netbuf-static.h>
+#include <embr/netbuf-dynamic.h>
+
+#include <stdlib.h>
+
+using namespace embr;
+
+namespace {
+
+struct NoMinimumPolicy : mem::experimental::NetBufDynamicDefaultPolicy
+{
+    CONSTEXPR int minimum_allocation_size() const { return 1; }
+};
+
+typedef mem::experimental::NetBufDynamic< std::allocator<uint8_t>, NoMinimumPolicy > chain_type;
+
+// lays 'data' out across a chain of chunks sized per 'sizes', cycling through sizes
+// as many times as needed
+void fill_chain(chain_type& nb, const uint8_t* data, size_t n, const int* sizes, int size_count)
+{
+    for(int i = 0; n > 0; i = (i + 1) % size_count)
+    {
+        size_t sz = (size_t)sizes[i] < n ? sizes[i] : n;
+
+        nb.expand(sz, true);
+        memcpy(nb.data(), data, sz);
+        data += sz;
+        n -= sz;
+    }
+
+    nb.reset();
+}
+
+// straight from RFC 1071 section 4.1
+uint16_t reference_checksum(const uint8_t* p, size_t n)
+{
+    uint32_t sum = 0;
+
+    for(; n > 1; n -= 2, p += 2)
+        sum += (p[0] << 8) | p[1];
+
+    if(n) sum += p[0] << 8;
+
+    while(sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+
+    return (uint16_t)~sum;
+}
+
+}
+
+TEST_CASE("checksum")
+{
+    SECTION("internet checksum")
+    {
+        SECTION("RFC 1071 example")
+        {
+            const uint8_t data[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7 };
+            experimental::InternetChecksum c;
+
+            c.update(data, sizeof(data));
+
+            REQUIRE(c.sum() == 0xddf2);
+            REQUIRE(c.value() == 0x220d);
+        }
+        SECTION("odd length splits")
+        {
+            const uint8_t data[] = { 0x00, 0x01, 0xf2, 0x03, 0xf4, 0xf5, 0xf6, 0xf7, 0x11 };
+
+            for(size_t split = 0; split <= sizeof(data); split++)
+            {
+                experimental::InternetChecksum c;
+
+                c.update(data, split);
+                c.update(data + split, sizeof(data) - split);
+
+                REQUIRE(c.value() == reference_checksum(data, sizeof(data)));
+            }
+        }
+        SECTION("large buffer")
+        {
+            // big enough to exercise vector paths, odd so as to exercise the tail
+            uint8_t data[4099];
+
+            srand(0);
+            for(size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)rand();
+
+            experimental::InternetChecksum c;
+
+            c.update(data, sizeof(data));
+
+            REQUIRE(c.value() == reference_checksum(data, sizeof(data)));
+
+            c.reset();
+            c.update(data + 1, sizeof(data) - 1);
+
+            REQUIRE(c.value() == reference_checksum(data + 1, sizeof(data) - 1));
+        }
+    }
+    SECTION("crc32")
+    {
+        const char* check = "123456789";
+
+        experimental::Crc32Ieee crc;
+        experimental::Crc32c crcc;
+
+        crc.update(check, 9);
+        crcc.update(check, 9);
+
+        REQUIRE(crc.value() == 0xCBF43926);
+        REQUIRE(crcc.value() == 0xE3069283);
+
+        crc.reset();
+        crc.update(check, 4);
+        crc.update(check + 4, 5);
+
+        REQUIRE(crc.value() == 0xCBF43926);
+    }
+    SECTION("netbuf chain")
+    {
+        uint8_t data[1001];
+
+        srand(1);
+        for(size_t i = 0; i < sizeof(data); i++) data[i] = (uint8_t)rand();
+
+        experimental::Crc32Ieee crc;
+        experimental::Crc32c crcc;
+
+        crc.update(data, sizeof(data));
+        crcc.update(data, sizeof(data));
+
+        const int sizes[] = { 1, 7, 64, 3, 100, 2 };
+
+        chain_type nb;
+
+        fill_chain(nb, data, sizeof(data), sizes, 6);
+
+        REQUIRE(nb.chunk_count() > 6);
+
+        // walk one chunk in, to ensure helpers put us back where we were
+        nb.next();
+        const void* here = nb.data();
+
+        REQUIRE(experimental::internet_checksum(nb) == reference_checksum(data, sizeof(data)));
+        REQUIRE(experimental::crc32(nb) == crc.value());
+        REQUIRE(experimental::crc32c(nb) == crcc.value());
+        REQUIRE(nb.data() == here);
+
+        SECTION("non chained")
+        {
+            mem::layer1::NetBuf<sizeof(data)> nb1;
+
+            memcpy(nb1.data(), data, sizeof(data));
+
+            REQUIRE(experimental::internet_checksum(nb1) == reference_checksum(data, sizeof(data)));
+            REQUIRE(experimental::crc32(nb1) == crc.value());
+        }
+    }
+}
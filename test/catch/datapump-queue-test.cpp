@@ -0,0 +1,740 @@
+#include <catch.hpp>
+
+#include <embr/datapump.hpp>
+#include <embr/datapump-queue.h>
+#include <embr/dataport.hpp>
+#include "datapump-test.h"
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef embr::DataPump<synthetic_transport_descriptor,
+    embr::EmptyAppDataSpscQueuePolicy<4> > spsc_datapump;
+typedef embr::DataPump<synthetic_transport_descriptor,
+    embr::EmptyAppDataMpmcQueuePolicy<8> > mpmc_datapump;
+
+namespace {
+
+// tallies up processed items, from any number of service() threads
+template <class TDatapump>
+struct CountingSubject
+{
+    typedef embr::DataPortEvents<TDatapump> event;
+
+    std::atomic<int> dequeued;
+    std::atomic<int> sent;
+    std::atomic<int> batches;
+    std::atomic<int> overflows;
+    // counters carried by most recent overflow event
+    embr::QueueCounters last_counters;
+
+    CountingSubject() : dequeued(0), sent(0), batches(0), overflows(0) {}
+
+    template <class TContext>
+    void notify(const typename event::receive_dequeued&, TContext&) { dequeued++; }
+
+    template <class TContext>
+    void notify(const typename event::transport_sent&, TContext&) { sent++; }
+
+    template <class TContext>
+    void notify(const typename event::receive_batch_dequeued& e, TContext&)
+    {
+        batches++;
+        dequeued += (int)e.count;
+    }
+
+    template <class TContext>
+    void notify(const typename event::send_batch_sent& e, TContext&)
+    {
+        batches++;
+        sent += (int)e.count;
+    }
+
+    template <class TContext>
+    void notify(const typename event::queue_dropped_newest& e, TContext&) { overflowed(e); }
+
+    template <class TContext>
+    void notify(const typename event::queue_dropped_oldest& e, TContext&) { overflowed(e); }
+
+    template <class TContext>
+    void notify(const typename event::queue_rejected& e, TContext&) { overflowed(e); }
+
+    template <class TContext>
+    void notify(const typename event::queue_timed_out& e, TContext&) { overflowed(e); }
+
+    template <class TEvent, class TContext>
+    void notify(const TEvent&, TContext&) {}
+
+    template <class TCounters>
+    void overflowed(const embr::event::QueueOverflowBase<TCounters>& e)
+    {
+        overflows++;
+        last_counters = e.counters;
+    }
+};
+
+// notes, for each send_dequeued, its addr and whether the outgoing queue was by then empty -
+// i.e. whether the sent item had already been released
+template <class TDatapump>
+struct ReleaseOrderSubject
+{
+    typedef embr::DataPortEvents<TDatapump> event;
+
+    TDatapump* datapump;
+    std::vector<int> addrs;
+    int released;
+
+    ReleaseOrderSubject() : datapump(NULLPTR), released(0) {}
+
+    template <class TContext>
+    void notify(const typename event::send_dequeued& e, TContext&)
+    {
+        addrs.push_back(e.addr);
+        if(datapump->transport_empty()) released++;
+    }
+
+    template <class TEvent, class TContext>
+    void notify(const TEvent&, TContext&) {}
+};
+
+struct NullTransport
+{
+    typedef synthetic_transport_descriptor transport_descriptor_t;
+
+    NullTransport(void*) {}
+
+    void send(synthetic_netbuf_type&, int) {}
+};
+
+}
+
+TEST_CASE("datapump queue policies", "[datapump]")
+{
+    SECTION("spsc ring")
+    {
+        embr::experimental::SpscRing<int, 3> ring;
+
+        REQUIRE(ring.empty());
+        REQUIRE(!ring.full());
+
+        // go around a few times to exercise wrap
+        for(int i = 0; i < 10; i++)
+        {
+            REQUIRE(ring.push(i * 3));
+            REQUIRE(ring.back() == i * 3);
+            ring.emplace(i * 3 + 1);
+            REQUIRE(ring.try_emplace(i * 3 + 2) != NULLPTR);
+            REQUIRE(ring.full());
+            REQUIRE(ring.size() == 3);
+            REQUIRE(!ring.push(-1));
+
+            for(int j = 0; j < 3; j++)
+            {
+                REQUIRE(!ring.empty());
+                REQUIRE(ring.front() == i * 3 + j);
+                ring.pop();
+            }
+
+            REQUIRE(ring.empty());
+        }
+    }
+    SECTION("spsc emplace waits for room")
+    {
+        embr::experimental::SpscRing<int, 2> ring;
+
+        ring.emplace(0);
+        ring.emplace(1);
+
+        REQUIRE(ring.full());
+
+        std::thread consumer([&]()
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            ring.pop();
+        });
+
+        // full, so blocks until consumer pops
+        REQUIRE(ring.emplace(2) == 2);
+
+        consumer.join();
+
+        REQUIRE(ring.size() == 2);
+        REQUIRE(ring.front() == 1);
+    }
+    SECTION("datapump")
+    {
+        spsc_datapump dp;
+        synthetic_netbuf_type nb;
+
+        REQUIRE(dp.dequeue_empty());
+
+        dp.transport_in(std::move(nb), 7);
+
+        REQUIRE(!dp.dequeue_empty());
+        REQUIRE(dp.dequeue_front().addr() == 7);
+
+        dp.dequeue_pop();
+
+        REQUIRE(dp.dequeue_empty());
+
+        synthetic_netbuf_type nb2;
+
+        dp.enqueue_out(std::move(nb2), 8);
+
+        REQUIRE(!dp.transport_empty());
+        REQUIRE(dp.transport_front().addr() == 8);
+
+        dp.transport_pop();
+
+        REQUIRE(dp.transport_empty());
+    }
+    SECTION("two thread stress")
+    {
+        // non trivial payload so that sanitizers have a chance to notice a torn
+        // construct/destruct
+        struct Item
+        {
+            int seq;
+            std::string payload;
+
+            Item(int seq) : seq(seq), payload(std::to_string(seq) + " of many bytes") {}
+        };
+
+        const int count = 1000000;
+        embr::experimental::SpscRing<Item, 64> ring;
+        int mismatches = 0;
+
+        std::thread consumer([&]()
+        {
+            for(int expected = 0; expected < count;)
+            {
+                if(ring.empty())
+                {
+                    std::this_thread::yield();
+                    continue;
+                }
+
+                Item& item = ring.front();
+
+                if(item.seq != expected || item.payload != std::to_string(expected) + " of many bytes")
+                    mismatches++;
+
+                ring.pop();
+                expected++;
+            }
+        });
+
+        for(int i = 0; i < count; i++)
+        {
+            while(ring.try_emplace(i) == NULLPTR)
+                std::this_thread::yield();
+        }
+
+        consumer.join();
+
+        REQUIRE(mismatches == 0);
+        REQUIRE(ring.empty());
+    }
+    SECTION("mpmc ring")
+    {
+        embr::experimental::MpmcRing<int, 4> ring;
+
+        REQUIRE(ring.empty());
+        REQUIRE(ring.try_claim() == NULLPTR);
+
+        for(int i = 0; i < 4; i++) REQUIRE(ring.push(i));
+
+        REQUIRE(!ring.push(4));
+        REQUIRE(ring.size() == 4);
+
+        // claims may be released out of order
+        int* a = ring.try_claim();
+        int* b = ring.try_claim();
+
+        REQUIRE(*a == 0);
+        REQUIRE(*b == 1);
+
+        ring.release(b);
+
+        // cell of 'a' is still held, so still no room
+        REQUIRE(!ring.push(4));
+
+        ring.release(a);
+
+        REQUIRE(ring.push(4));
+        REQUIRE(ring.push(5));
+
+        for(int i = 2; i < 6; i++)
+        {
+            int* p = ring.try_claim();
+
+            REQUIRE(p != NULLPTR);
+            REQUIRE(*p == i);
+            ring.release(p);
+        }
+
+        REQUIRE(ring.empty());
+    }
+    SECTION("mpmc stress")
+    {
+        const int producers = 3;
+        const int consumers = 3;
+        const int per_producer = 100000;
+
+        embr::experimental::MpmcRing<int, 32> ring;
+        std::vector<std::atomic<int> > seen(producers * per_producer);
+        std::atomic<int> consumed(0);
+        std::vector<std::thread> threads;
+
+        for(int i = 0; i < producers * per_producer; i++) seen[i] = 0;
+
+        for(int t = 0; t < consumers; t++)
+            threads.emplace_back([&]()
+            {
+                while(consumed < producers * per_producer)
+                {
+                    int* p = ring.try_claim();
+
+                    if(p == NULLPTR)
+                    {
+                        std::this_thread::yield();
+                        continue;
+                    }
+
+                    seen[*p]++;
+                    ring.release(p);
+                    consumed++;
+                }
+            });
+
+        for(int t = 0; t < producers; t++)
+            threads.emplace_back([&, t]()
+            {
+                for(int i = 0; i < per_producer; i++)
+                    ring.emplace(t * per_producer + i);
+            });
+
+        for(std::thread& t : threads) t.join();
+
+        int wrong = 0;
+
+        for(int i = 0; i < producers * per_producer; i++)
+            if(seen[i] != 1) wrong++;
+
+        REQUIRE(wrong == 0);
+        REQUIRE(ring.empty());
+    }
+    SECTION("concurrent dataport service")
+    {
+        typedef CountingSubject<mpmc_datapump> subject_type;
+        typedef embr::DataPort<mpmc_datapump, NullTransport, subject_type&> dataport_type;
+
+        const int count = 20000;
+        const int workers = 3;
+
+        subject_type subject;
+        dataport_type dataport(subject);
+        std::vector<std::thread> threads;
+
+        // every item has to make it through, so wait for workers to make room
+        dataport.datapump.incoming_overflow_strategy(embr::QueueOverflowBlock, ~0U);
+        dataport.datapump.outgoing_overflow_strategy(embr::QueueOverflowBlock, ~0U);
+
+        for(int t = 0; t < workers; t++)
+            threads.emplace_back([&]()
+            {
+                while(subject.dequeued < count || subject.sent < count)
+                    dataport.service();
+            });
+
+        for(int i = 0; i < count; i++)
+        {
+            dataport.enqueue_from_receive(synthetic_netbuf_type(), i);
+            dataport.enqueue_for_send(synthetic_netbuf_type(), i);
+        }
+
+        for(std::thread& t : threads) t.join();
+
+        REQUIRE(subject.dequeued == count);
+        REQUIRE(subject.sent == count);
+        REQUIRE(dataport.datapump.dequeue_empty());
+        REQUIRE(dataport.datapump.transport_empty());
+    }
+    SECTION("bulk")
+    {
+        int values[5] = { 0, 1, 2, 3, 4 };
+        int* claimed[8];
+        auto construct = [&](void* storage, size_t i) { new (storage) int(values[i]); };
+
+        SECTION("spsc ring")
+        {
+            embr::experimental::SpscRing<int, 4> ring;
+
+            REQUIRE(ring.emplace_bulk(5, construct) == 4);
+            REQUIRE(ring.full());
+            REQUIRE(ring.claim_bulk(claimed, 3) == 3);
+            REQUIRE(*claimed[2] == 2);
+
+            ring.release_bulk(claimed, 3);
+
+            // wraps around
+            REQUIRE(ring.emplace_bulk(2, construct) == 2);
+            REQUIRE(ring.claim_bulk(claimed, 8) == 3);
+            REQUIRE(*claimed[0] == 3);
+            REQUIRE(*claimed[1] == 0);
+            REQUIRE(*claimed[2] == 1);
+
+            ring.release_bulk(claimed, 3);
+
+            REQUIRE(ring.empty());
+            REQUIRE(ring.claim_bulk(claimed, 8) == 0);
+        }
+        SECTION("mpmc ring")
+        {
+            embr::experimental::MpmcRing<int, 4> ring;
+
+            REQUIRE(ring.emplace_bulk(5, construct) == 4);
+            REQUIRE(ring.emplace_bulk(1, construct) == 0);
+            REQUIRE(ring.claim_bulk(claimed, 3) == 3);
+            REQUIRE(*claimed[2] == 2);
+
+            ring.release_bulk(claimed, 3);
+
+            REQUIRE(ring.emplace_bulk(2, construct) == 2);
+            REQUIRE(ring.claim_bulk(claimed, 8) == 3);
+            REQUIRE(*claimed[0] == 3);
+            REQUIRE(*claimed[2] == 1);
+
+            ring.release_bulk(claimed, 3);
+
+            REQUIRE(ring.empty());
+            REQUIRE(ring.claim_bulk(claimed, 8) == 0);
+        }
+        SECTION("datapump")
+        {
+            spsc_datapump dp;
+            synthetic_netbuf_type netbufs[5];
+            const int addrs[5] = { 10, 11, 12, 13, 14 };
+            spsc_datapump::Item* items[8];
+
+            REQUIRE(dp.enqueue_bulk(netbufs, addrs, 5) == 4);
+            REQUIRE(dp.transport_claim_bulk(items, 8) == 4);
+            REQUIRE(items[3]->addr() == 13);
+
+            dp.transport_release_bulk(items, 4);
+
+            REQUIRE(dp.transport_empty());
+            REQUIRE(dp.dequeue_bulk(items, 8) == 0);
+        }
+        SECTION("service_batch")
+        {
+            typedef CountingSubject<mpmc_datapump> subject_type;
+            typedef embr::DataPort<mpmc_datapump, NullTransport, subject_type&> dataport_type;
+
+            subject_type subject;
+            dataport_type dataport(subject);
+
+            for(int i = 0; i < 6; i++)
+            {
+                dataport.enqueue_from_receive(synthetic_netbuf_type(), i);
+                dataport.enqueue_for_send(synthetic_netbuf_type(), i);
+            }
+
+            SECTION("per item events")
+            {
+                REQUIRE(dataport.service_batch<4>(5) == 10);
+                REQUIRE(subject.dequeued == 5);
+                REQUIRE(subject.sent == 5);
+                REQUIRE(subject.batches == 0);
+
+                REQUIRE(dataport.service_batch<4>(100) == 2);
+            }
+            SECTION("aggregate")
+            {
+                REQUIRE(dataport.service_batch<4>(100, true) == 12);
+                REQUIRE(subject.dequeued == 6);
+                REQUIRE(subject.sent == 6);
+                // 4 + 2 in each direction
+                REQUIRE(subject.batches == 4);
+            }
+
+            REQUIRE(dataport.datapump.dequeue_empty());
+            REQUIRE(dataport.datapump.transport_empty());
+        }
+        SECTION("send_dequeued follows release")
+        {
+            // single consumer ring only frees up slots upon release, so transport_empty()
+            // tells released from merely claimed
+            typedef ReleaseOrderSubject<spsc_datapump> subject_type;
+            typedef embr::DataPort<spsc_datapump, NullTransport, subject_type&> dataport_type;
+
+            subject_type subject;
+            dataport_type dataport(subject);
+
+            subject.datapump = &dataport.datapump;
+
+            SECTION("service")
+            {
+                dataport.enqueue_for_send(synthetic_netbuf_type(), 7);
+                dataport.service();
+            }
+            SECTION("service_batch")
+            {
+                for(int i = 0; i < 3; i++)
+                    dataport.enqueue_for_send(synthetic_netbuf_type(), 7 + i);
+
+                REQUIRE(dataport.service_batch<4>(100) == 3);
+                REQUIRE(subject.addrs.size() == 3);
+                REQUIRE(subject.addrs[2] == 9);
+            }
+
+            REQUIRE(subject.addrs[0] == 7);
+            REQUIRE(subject.released == (int)subject.addrs.size());
+        }
+    }
+    SECTION("overflow")
+    {
+        typedef embr::DataPump<synthetic_transport_descriptor,
+            embr::EmptyAppDataMpmcQueuePolicy<2, 4> > datapump_type;
+        typedef embr::DataPump<synthetic_transport_descriptor,
+            embr::EmptyAppDataSpscQueuePolicy<2> > spsc_datapump_type;
+
+        embr::QueueStatus status;
+
+        SECTION("separate capacities")
+        {
+            datapump_type dp;
+
+            REQUIRE(dp.incoming_capacity() == 2);
+            REQUIRE(dp.outgoing_capacity() == 4);
+
+            // thread safe policies reject by default, rather than hold up producer
+
+            for(int i = 0; i < 4; i++)
+            {
+                REQUIRE(dp.enqueue_out(synthetic_netbuf_type(), i, &status) != NULLPTR);
+                REQUIRE(status == embr::QueueOK);
+            }
+
+            REQUIRE(dp.enqueue_out(synthetic_netbuf_type(), 4, &status) == NULLPTR);
+            REQUIRE(status == embr::QueueRejected);
+
+            REQUIRE(dp.transport_in(synthetic_netbuf_type(), 0) != NULLPTR);
+            REQUIRE(dp.transport_in(synthetic_netbuf_type(), 1) != NULLPTR);
+            REQUIRE(dp.transport_in(synthetic_netbuf_type(), 2, &status) == NULLPTR);
+            REQUIRE(status == embr::QueueRejected);
+
+            REQUIRE(dp.incoming_counters().rejected == 1);
+            REQUIRE(dp.outgoing_counters().rejected == 1);
+        }
+        SECTION("drop newest")
+        {
+            datapump_type dp;
+
+            dp.incoming_overflow_strategy(embr::QueueOverflowDropNewest);
+
+            for(int i = 0; i < 3; i++) dp.transport_in(synthetic_netbuf_type(), i, &status);
+
+            REQUIRE(status == embr::QueueDroppedNewest);
+            REQUIRE(dp.incoming_counters().dropped_newest == 1);
+            REQUIRE(dp.dequeue_claim()->addr() == 0);
+        }
+        SECTION("drop oldest")
+        {
+            datapump_type dp;
+
+            dp.incoming_overflow_strategy(embr::QueueOverflowDropOldest);
+
+            for(int i = 0; i < 4; i++) dp.transport_in(synthetic_netbuf_type(), i, &status);
+
+            REQUIRE(status == embr::QueueOKDroppedOldest);
+            REQUIRE(dp.incoming_counters().dropped_oldest == 2);
+
+            datapump_type::Item* item = dp.dequeue_claim();
+
+            REQUIRE(item->addr() == 2);
+            dp.dequeue_release(item);
+            REQUIRE(dp.dequeue_claim()->addr() == 3);
+        }
+        SECTION("single consumer queue rejects by default")
+        {
+            spsc_datapump_type dp;
+
+            for(int i = 0; i < 3; i++) dp.transport_in(synthetic_netbuf_type(), i, &status);
+
+            // nobody waits on network stack's behalf unless asked to
+            REQUIRE(status == embr::QueueRejected);
+            REQUIRE(dp.incoming_counters().rejected == 1);
+        }
+        SECTION("drop oldest on single consumer queue")
+        {
+            spsc_datapump_type dp;
+
+            // producer can't pop, so this one falls back to reject
+            dp.incoming_overflow_strategy(embr::QueueOverflowDropOldest);
+
+            for(int i = 0; i < 3; i++) dp.transport_in(synthetic_netbuf_type(), i, &status);
+
+            REQUIRE(status == embr::QueueRejected);
+            REQUIRE(dp.incoming_counters().rejected == 1);
+            REQUIRE(dp.dequeue_front().addr() == 0);
+        }
+        SECTION("tallies from several producers")
+        {
+            datapump_type dp;
+
+            dp.incoming_overflow_strategy(embr::QueueOverflowReject);
+
+            dp.transport_in(synthetic_netbuf_type(), 0);
+            dp.transport_in(synthetic_netbuf_type(), 1);
+
+            const int producers = 4;
+            const int per_producer = 1000;
+            std::vector<std::thread> threads;
+
+            for(int t = 0; t < producers; t++)
+                threads.emplace_back([&]()
+                {
+                    for(int i = 0; i < per_producer; i++)
+                        dp.transport_in(synthetic_netbuf_type(), 2);
+                });
+
+            for(std::thread& t : threads) t.join();
+
+            // no increments lost to racing producers
+            REQUIRE(dp.incoming_counters().rejected == producers * per_producer);
+        }
+        SECTION("block")
+        {
+            datapump_type dp;
+
+            dp.incoming_overflow_strategy(embr::QueueOverflowBlock, 10);
+
+            dp.transport_in(synthetic_netbuf_type(), 0);
+            dp.transport_in(synthetic_netbuf_type(), 1);
+
+            SECTION("times out")
+            {
+                REQUIRE(dp.transport_in(synthetic_netbuf_type(), 2, &status) == NULLPTR);
+                REQUIRE(status == embr::QueueTimedOut);
+                REQUIRE(dp.incoming_counters().timed_out == 1);
+            }
+            SECTION("times out while consumer holds a claim")
+            {
+                // claimed cell no longer counts towards size(), but isn't free either
+                auto claimed = dp.dequeue_claim();
+
+                REQUIRE(dp.transport_in(synthetic_netbuf_type(), 2, &status) == NULLPTR);
+                REQUIRE(status == embr::QueueTimedOut);
+                REQUIRE(dp.incoming_counters().timed_out == 1);
+
+                dp.dequeue_release(claimed);
+
+                REQUIRE(dp.transport_in(synthetic_netbuf_type(), 2, &status) != NULLPTR);
+                REQUIRE(status == embr::QueueOK);
+            }
+            SECTION("consumer makes room")
+            {
+                dp.incoming_overflow_strategy(embr::QueueOverflowBlock, 10000);
+
+                std::thread consumer([&]()
+                {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+                    dp.dequeue_release(dp.dequeue_claim());
+                });
+
+                REQUIRE(dp.transport_in(synthetic_netbuf_type(), 2, &status) != NULLPTR);
+                REQUIRE(status == embr::QueueOK);
+
+                consumer.join();
+
+                REQUIRE(dp.incoming_counters().timed_out == 0);
+            }
+        }
+        SECTION("events")
+        {
+            typedef CountingSubject<spsc_datapump_type> subject_type;
+            typedef embr::DataPort<spsc_datapump_type, NullTransport, subject_type&> dataport_type;
+
+            subject_type subject;
+            dataport_type dataport(subject);
+
+            dataport.datapump.incoming_overflow_strategy(embr::QueueOverflowReject);
+            dataport.datapump.outgoing_overflow_strategy(embr::QueueOverflowDropNewest);
+
+            for(int i = 0; i < 3; i++)
+                REQUIRE(dataport.enqueue_from_receive(synthetic_netbuf_type(), i) ==
+                    (i < 2 ? embr::QueueOK : embr::QueueRejected));
+
+            REQUIRE(subject.overflows == 1);
+            REQUIRE(subject.last_counters.rejected == 1);
+
+            for(int i = 0; i < 4; i++) dataport.enqueue_for_send(synthetic_netbuf_type(), i);
+
+            REQUIRE(subject.overflows == 3);
+            REQUIRE(subject.last_counters.dropped_newest == 2);
+            REQUIRE(subject.last_counters.rejected == 0);
+        }
+    }
+    SECTION("mpmc bulk stress")
+    {
+        const int producers = 2;
+        const int consumers = 2;
+        const int per_producer = 100000;
+
+        embr::experimental::MpmcRing<int, 32> ring;
+        std::vector<std::atomic<int> > seen(producers * per_producer);
+        std::atomic<int> consumed(0);
+        std::vector<std::thread> threads;
+
+        for(int i = 0; i < producers * per_producer; i++) seen[i] = 0;
+
+        for(int t = 0; t < consumers; t++)
+            threads.emplace_back([&]()
+            {
+                int* claimed[7];
+
+                while(consumed < producers * per_producer)
+                {
+                    size_t n = ring.claim_bulk(claimed, 7);
+
+                    if(n == 0) std::this_thread::yield();
+
+                    for(size_t i = 0; i < n; i++) seen[*claimed[i]]++;
+
+                    ring.release_bulk(claimed, n);
+                    consumed += (int)n;
+                }
+            });
+
+        for(int t = 0; t < producers; t++)
+            threads.emplace_back([&, t]()
+            {
+                for(int i = 0; i < per_producer;)
+                {
+                    int base = t * per_producer + i;
+                    size_t want = per_producer - i < 5 ? per_producer - i : 5;
+                    size_t n = ring.emplace_bulk(want, [&](void* storage, size_t j)
+                    {
+                        new (storage) int(base + (int)j);
+                    });
+
+                    if(n == 0) std::this_thread::yield();
+
+                    i += (int)n;
+                }
+            });
+
+        for(std::thread& t : threads) t.join();
+
+        int wrong = 0;
+
+        for(int i = 0; i < producers * per_producer; i++)
+            if(seen[i] != 1) wrong++;
+
+        REQUIRE(wrong == 0);
+        REQUIRE(ring.empty());
+    }
+}
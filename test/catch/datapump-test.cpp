@@ -8,6 +8,28 @@
 
 using namespace embr::experimental;
 
+// upstream which runs dry after 'budget' allocations
+template <class T>
+struct LimitedAllocator
+{
+    typedef T value_type;
+
+    static int budget;
+
+    T* allocate(size_t n)
+    {
+        if(budget == 0) return NULLPTR;
+
+        --budget;
+        return static_cast<T*>(::operator new(n * sizeof(T)));
+    }
+
+    void deallocate(T* p, size_t) { ::operator delete(p); }
+};
+
+template <class T>
+int LimitedAllocator<T>::budget = 0;
+
 // specifically for v2 experimental datapump/dataport
 struct FakeTransport
 {
@@ -37,6 +59,12 @@ struct SyntheticRetry : BasicRetry<const char*, int>
 
         bool is_acknowledge() { return this->pbuf[0] == 'A'; }
 
+        // same for a CON and its ACK, for RetryIndexedPolicy
+        uint32_t retry_hash()
+        {
+            return internal::hash_combine(internal::hash_mix(seq()), addr);
+        }
+
         // evaluate whether the incoming item is an ACK matching 'this' item
         // expected to be a CON.  Comparing against something without retry metadata
         // because a JUST RECEIVED ACK item won't have any retry metadata yet
@@ -58,6 +86,11 @@ struct SyntheticRetry : BasicRetry<const char*, int>
     {
         return item->counter() < 3;
     }
+
+    bool should_resend(RetryItem* item)
+    {
+        return should_queue(item);
+    }
 };
 
 
@@ -100,6 +133,93 @@ TEST_CASE("datapump")
 
             datapump.deallocate(item);
         }
+        SECTION("pool")
+        {
+            typedef Datapump2CoreItem<const char*, int> item_type;
+            PoolStatus status;
+
+            SECTION("fixed")
+            {
+                Datapump2<const char*, int, item_type, Datapump2FixedPoolPolicy<2> > datapump;
+
+                REQUIRE(datapump.pool_capacity() == 2);
+
+                datapump.enqueue_from_transport("1", 1);
+                datapump.enqueue_from_transport("2", 2, &status);
+
+                REQUIRE(status == PoolOK);
+                REQUIRE(datapump.enqueue_from_transport("3", 3, &status) == NULLPTR);
+                REQUIRE(status == PoolExhausted);
+                REQUIRE(datapump.pool_counters().exhausted == 1);
+
+                item_type* item = datapump.dequeue_from_transport();
+
+                REQUIRE(item->addr == 1);
+
+                datapump.deallocate(item);
+
+                REQUIRE(datapump.enqueue_from_transport("3", 3, &status) != NULLPTR);
+                REQUIRE(datapump.pool_counters().in_use == 2);
+                REQUIRE(datapump.pool_counters().high_water == 2);
+            }
+            SECTION("segmented")
+            {
+                Datapump2<const char*, int, item_type, Datapump2SegmentedPoolPolicy<2, 3> > datapump;
+
+                for(int i = 0; i < 6; i++)
+                {
+                    REQUIRE(datapump.enqueue_from_transport("hi", i, &status) != NULLPTR);
+                    REQUIRE(status == (i == 2 || i == 4 ? PoolGrew : PoolOK));
+                }
+
+                REQUIRE(datapump.pool_capacity() == 6);
+                REQUIRE(datapump.enqueue_from_transport("hi", 6, &status) == NULLPTR);
+                REQUIRE(status == PoolExhausted);
+
+                // slabs stay put, and freed items are reused before anything else
+                for(int i = 0; i < 6; i++)
+                {
+                    item_type* item = datapump.dequeue_from_transport();
+
+                    REQUIRE(item->addr == i);
+
+                    datapump.deallocate(item);
+                }
+
+                REQUIRE(datapump.pool_capacity() == 6);
+                REQUIRE(datapump.enqueue_from_transport("hi", 7, &status) != NULLPTR);
+                REQUIRE(status == PoolOK);
+                REQUIRE(datapump.pool_counters().high_water == 6);
+            }
+            SECTION("segmented reserve")
+            {
+                Datapump2SegmentedPoolPolicy<4>::Pool<item_type> pool;
+
+                REQUIRE(pool.reserve(9));
+                REQUIRE(pool.slab_count() == 3);
+
+                for(int i = 0; i < 12; i++) REQUIRE(pool.allocate() != NULLPTR);
+
+                REQUIRE(pool.slab_count() == 3);
+            }
+            SECTION("segmented, upstream runs out")
+            {
+                typedef LimitedAllocator<uint8_t> upstream_type;
+
+                Datapump2<const char*, int, item_type,
+                    Datapump2SegmentedPoolPolicy<2, 0, upstream_type> > datapump;
+
+                upstream_type::budget = 1;
+
+                for(int i = 0; i < 4; i++)
+                    REQUIRE(datapump.enqueue_from_transport("hi", i, &status) != NULLPTR);
+
+                REQUIRE(datapump.enqueue_from_transport("hi", 4, &status) == NULLPTR);
+                REQUIRE(status == PoolExhausted);
+                REQUIRE(datapump.pool_counters().exhausted == 1);
+                REQUIRE(datapump.pool_capacity() == 4);
+            }
+        }
         SECTION("retry")
         {
             typedef Retry2<const char*, int, SyntheticRetry> retry_type;
@@ -151,6 +271,361 @@ TEST_CASE("datapump")
             // old item sitting in retry queue is now removed and returned
             REQUIRE(to_remove == &item);
         }
+        SECTION("retry schedulers")
+        {
+            typedef BasicRetry<const char*, int> retry_impl_type;
+            typedef retry_impl_type::RetryItem item_type;
+            typedef retry_impl_type::clock_type clock_type;
+            typedef estd::chrono::milliseconds ms;
+
+            const clock_type::time_point now = clock_type::now();
+            item_type items[4];
+
+            SECTION("list")
+            {
+                Retry2<const char*, int, retry_impl_type> retry;
+
+                items[0]._due = now - ms(10);
+                items[1]._due = now - ms(30);
+                items[2]._due = now - ms(20);
+                items[3]._due = now + ms(3600000);
+
+                for(item_type& item : items) retry.add_to_retry(&item);
+
+                REQUIRE(retry.dequeue_retry_ready() == &items[1]);
+                REQUIRE(retry.dequeue_retry_ready() == &items[2]);
+                REQUIRE(retry.dequeue_retry_ready() == &items[0]);
+                REQUIRE(retry.dequeue_retry_ready() == NULLPTR);
+
+                REQUIRE(retry.remove_from_retry(&items[3]));
+                REQUIRE(!retry.remove_from_retry(&items[3]));
+                REQUIRE(retry.retry_list.empty());
+            }
+            SECTION("list drain")
+            {
+                typedef Retry2<const char*, int, retry_impl_type> retry_type;
+                retry_type retry;
+                retry_type::ready_list_type ready;
+
+                REQUIRE(!retry.next_deadline());
+
+                items[0]._due = now - ms(10);
+                items[1]._due = now - ms(30);
+                items[2]._due = now + ms(20);
+                items[3]._due = now - ms(20);
+
+                for(item_type& item : items) retry.add_to_retry(&item);
+
+                REQUIRE(*retry.next_deadline() == items[1]._due);
+
+                REQUIRE(retry.dequeue_retry_ready(now, ready) == 3);
+
+                REQUIRE(&ready.front() == &items[1]);
+                ready.pop_front();
+                REQUIRE(&ready.front() == &items[3]);
+                ready.pop_front();
+                REQUIRE(&ready.front() == &items[0]);
+                ready.pop_front();
+                REQUIRE(ready.empty());
+
+                REQUIRE(*retry.next_deadline() == items[2]._due);
+                REQUIRE(retry.dequeue_retry_ready(now, ready) == 0);
+                REQUIRE(retry.dequeue_retry_ready(now + ms(20), ready) == 1);
+                REQUIRE(&ready.front() == &items[2]);
+                REQUIRE(!retry.next_deadline());
+            }
+            SECTION("wheel")
+            {
+                // 8 slots of 10ms = 80ms per revolution
+                Retry2<const char*, int, retry_impl_type, item_type,
+                    RetryWheelPolicy<8, 10> > retry;
+
+                items[0]._due = now - ms(50);
+                items[1]._due = now - ms(10);
+                // same bucket as items[0], but one revolution later
+                items[2]._due = items[0]._due + ms(80);
+                items[3]._due = now + ms(3600000);
+
+                for(item_type& item : items) retry.add_to_retry(&item);
+
+                REQUIRE(retry.retry_list.size() == 4);
+
+                item_type* first = retry.dequeue_retry_ready();
+                item_type* second = retry.dequeue_retry_ready();
+
+                REQUIRE(first == &items[0]);
+                REQUIRE(second == &items[1]);
+                REQUIRE(retry.dequeue_retry_ready() == NULLPTR);
+
+                REQUIRE(retry.remove_from_retry(&items[2]));
+                REQUIRE(!retry.remove_from_retry(&items[2]));
+                REQUIRE(retry.retry_list.size() == 1);
+
+                // already overdue items are picked up even though sweep has moved on
+                items[2]._due = now - ms(500);
+                retry.add_to_retry(&items[2]);
+
+                REQUIRE(retry.dequeue_retry_ready() == &items[2]);
+                REQUIRE(retry.remove_from_retry(&items[3]));
+                REQUIRE(retry.retry_list.empty());
+            }
+            SECTION("wheel drain")
+            {
+                typedef Retry2<const char*, int, retry_impl_type, item_type,
+                    RetryWheelPolicy<8, 10> > retry_type;
+                retry_type retry;
+                retry_type::ready_list_type ready;
+
+                REQUIRE(!retry.next_deadline());
+
+                // more than a revolution out, so found by full search
+                items[0]._due = now + ms(500);
+                retry.add_to_retry(&items[0]);
+
+                REQUIRE(*retry.next_deadline() == items[0]._due);
+
+                items[1]._due = now + ms(30);
+                // same bucket as items[1], but one revolution later
+                items[2]._due = items[1]._due + ms(80);
+                retry.add_to_retry(&items[1]);
+                retry.add_to_retry(&items[2]);
+
+                REQUIRE(*retry.next_deadline() == items[1]._due);
+
+                items[3]._due = now - ms(200);
+                retry.add_to_retry(&items[3]);
+
+                REQUIRE(*retry.next_deadline() == items[3]._due);
+
+                // everything save items[0] comes due in one sweep
+                REQUIRE(retry.dequeue_retry_ready(now + ms(200), ready) == 3);
+
+                // having skipped ahead, wheel gives them up in bucket rather than due order
+                bool drained[4] = { false, false, false, false };
+
+                while(!ready.empty())
+                {
+                    drained[&ready.front() - items] = true;
+                    ready.pop_front();
+                }
+
+                REQUIRE(!drained[0]);
+                REQUIRE(drained[1]);
+                REQUIRE(drained[2]);
+                REQUIRE(drained[3]);
+
+                REQUIRE(*retry.next_deadline() == items[0]._due);
+                REQUIRE(retry.retry_list.size() == 1);
+            }
+            SECTION("indexed")
+            {
+                typedef SyntheticRetry::RetryItem synthetic_item_type;
+                // only 3 items fit in index, so the 4th is found by full search
+                Retry2<const char*, int, SyntheticRetry, synthetic_item_type,
+                    RetryIndexedPolicy<RetryWheelPolicy<8, 10>, 4> > retry;
+                static const char* cons[] = { "C0", "C1", "C2", "C3" };
+                synthetic_item_type sent[4], ack;
+
+                for(int i = 0; i < 4; i++)
+                {
+                    sent[i].pbuf = cons[i];
+                    sent[i].addr = i;
+                    sent[i]._due = now + ms(1000 * i);
+                    retry.add_to_retry(&sent[i]);
+                }
+
+                REQUIRE(retry.retry_list.load_factor() == 0.75f);
+                REQUIRE(retry.retry_list.index_overflow() == 1);
+
+                ack.pbuf = ACK_1;
+                ack.addr = 0;
+
+                // right sequence, wrong endpoint
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == NULLPTR);
+
+                ack.addr = 1;
+
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == &sent[1]);
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == NULLPTR);
+                REQUIRE(retry.retry_list.load_factor() == 0.5f);
+
+                ack.pbuf = "A3";
+                ack.addr = 3;
+
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == &sent[3]);
+                REQUIRE(retry.retry_list.index_overflow() == 0);
+
+                REQUIRE(retry.remove_from_retry(&sent[0]));
+                REQUIRE(retry.remove_from_retry(&sent[2]));
+                REQUIRE(retry.retry_list.load_factor() == 0);
+                REQUIRE(retry.retry_list.empty());
+            }
+            SECTION("indexed, stock retry item")
+            {
+                // BasicRetry's own item hashes by endpoint
+                typedef BasicRetry<const char*, int> retry_impl_type;
+                Retry2<const char*, int, retry_impl_type, retry_impl_type::RetryItem,
+                    RetryIndexedPolicy<RetryWheelPolicy<8, 10>, 4> > retry;
+                retry_impl_type::RetryItem sent[2], ack;
+
+                for(int i = 0; i < 2; i++)
+                {
+                    sent[i].pbuf = CON_0;
+                    sent[i].addr = i;
+                    sent[i]._due = now + ms(1000);
+                    retry.add_to_retry(&sent[i]);
+                }
+
+                REQUIRE(retry.retry_list.load_factor() == 0.5f);
+                REQUIRE(retry.retry_list.index_overflow() == 0);
+
+                ack.pbuf = ACK_0;
+                ack.addr = 1;
+
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == &sent[1]);
+                REQUIRE(retry.retry_list.load_factor() == 0.25f);
+                REQUIRE(retry.remove_from_retry(&sent[0]));
+                REQUIRE(retry.retry_list.empty());
+            }
+        }
+        SECTION("retry timing")
+        {
+            typedef Rfc7252RetryTiming timing;
+            typedef BasicRetry<const char*, int> retry_impl_type;
+            typedef retry_impl_type::clock_type clock_type;
+            typedef estd::chrono::milliseconds ms;
+
+            const clock_type::time_point now = clock_type::now();
+            // copied out, since REQUIRE would otherwise want storage for them
+            const uint32_t ack_timeout_ms = timing::ack_timeout_ms;
+            const uint32_t min_rto_ms = timing::min_rto_ms;
+            const unsigned max_retransmit = timing::max_retransmit;
+            const size_t endpoint_slots = timing::endpoint_slots;
+
+            SECTION("backoff")
+            {
+                retry_impl_type impl;
+                retry_impl_type::RetryItem item;
+
+                item.addr = 0;
+
+                REQUIRE(impl.should_queue(&item));
+
+                impl.queued(&item, now);
+
+                const uint32_t first = item.timeout_ms();
+
+                REQUIRE(first >= ack_timeout_ms);
+                REQUIRE(first <= ack_timeout_ms * timing::ack_random_factor_pct / 100);
+                REQUIRE(item.due() == now + ms(first));
+                REQUIRE(item.sent() == now);
+
+                for(unsigned i = 1; i <= max_retransmit; i++)
+                {
+                    // came due, so out it goes again
+                    REQUIRE(impl.should_resend(&item));
+                    REQUIRE(impl.should_queue(&item));
+
+                    impl.queued(&item, item.due());
+
+                    REQUIRE(item.timeout_ms() == first << i);
+                }
+
+                // MAX_RETRANSMIT retransmissions made.  Last one still gets its doubled
+                // timeout to be ACKed in, but once that lapses we give up
+                REQUIRE(item.counter() == (int)max_retransmit + 1);
+                REQUIRE(!impl.should_resend(&item));
+            }
+            SECTION("jitter")
+            {
+                retry_impl_type impl;
+                uint32_t lowest = ~0U, highest = 0;
+
+                for(int i = 0; i < 100; i++)
+                {
+                    uint32_t timeout = impl.initial_timeout(0);
+
+                    if(timeout < lowest) lowest = timeout;
+                    if(timeout > highest) highest = timeout;
+                }
+
+                REQUIRE(lowest >= 2000);
+                REQUIRE(highest <= 3000);
+                // spread across the range, so that senders don't all retransmit in lockstep
+                REQUIRE(highest - lowest > 500);
+            }
+            SECTION("rtt estimation")
+            {
+                RttTable<int> rtt;
+
+                REQUIRE(rtt.rto(1) == ack_timeout_ms);
+
+                // slow link.  First sample R gives RTO = R + 4 * R / 2
+                rtt.sample(1, 3000);
+
+                REQUIRE(rtt.rto(1) == 9000);
+
+                // steady samples shrink variance, so RTO closes in on SRTT
+                for(int i = 0; i < 20; i++) rtt.sample(1, 3000);
+
+                REQUIRE(rtt.rto(1) > ack_timeout_ms);
+                REQUIRE(rtt.rto(1) < 3100);
+
+                // fast link bottoms out at minimum RTO, well under ACK_TIMEOUT
+                rtt.sample(2, 50);
+
+                REQUIRE(rtt.rto(2) == min_rto_ms);
+                REQUIRE(rtt.size() == 2);
+
+                // endpoint 1 is least recently sampled, so is forgotten first
+                for(int addr = 3; addr < 3 + (int)endpoint_slots - 1; addr++)
+                    rtt.sample(addr, 100);
+
+                REQUIRE(rtt.size() == endpoint_slots);
+                REQUIRE(rtt.rto(1) == ack_timeout_ms);
+                REQUIRE(rtt.rto(2) == min_rto_ms);
+            }
+            SECTION("karn")
+            {
+                typedef Retry2<const char*, int, SyntheticRetry> retry_type;
+                typedef retry_type::item_type item_type;
+                retry_type retry;
+                item_type sent[2], ack;
+
+                sent[0].pbuf = CON_0;
+                sent[0].addr = 0;
+                sent[1].pbuf = "C1";
+                sent[1].addr = 1;
+
+                REQUIRE(retry.evaluate_add_to_retry(&sent[0]));
+                REQUIRE(retry.evaluate_add_to_retry(&sent[1]));
+
+                const uint32_t first = sent[1].timeout_ms();
+
+                // as if sent[1] came due and went out again
+                REQUIRE(retry.remove_from_retry(&sent[1]));
+                REQUIRE(retry.evaluate_add_to_retry(&sent[1]));
+                REQUIRE(sent[1].counter() == 2);
+                REQUIRE(sent[1].timeout_ms() == first * 2);
+
+                ack.pbuf = ACK_0;
+                ack.addr = 0;
+
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == &sent[0]);
+                REQUIRE(retry.impl().rtt.size() == 1);
+
+                ack.pbuf = ACK_1;
+                ack.addr = 1;
+
+                // retransmitted, so no telling which send this ACK answers - no sample
+                REQUIRE(retry.evaluate_remove_from_retry(&ack) == &sent[1]);
+                REQUIRE(retry.impl().rtt.size() == 1);
+
+                // near instant round trip, so endpoint 0 is down to minimum RTO
+                REQUIRE(retry.impl().rtt.rto(0) == min_rto_ms);
+                REQUIRE(retry.impl().rtt.rto(1) == ack_timeout_ms);
+            }
+        }
         SECTION("dataport")
         {
             typedef Dataport2<datapump_type> dataport_type;
@@ -217,6 +692,141 @@ TEST_CASE("datapump")
                 dataport.send_to_transport(CON_0, 0);
                 dataport.received_from_transport(ACK_0, 0);
             }
+            SECTION("retry drain")
+            {
+                typedef datapump_type::item_type item_type;
+                typedef datapump_type::clock_type clock_type;
+
+                const clock_type::time_point now = clock_type::now();
+                item_type items[3];
+
+                dataport.notifier = NULLPTR;
+
+                for(item_type& item : items)
+                {
+                    item.pbuf = CON_0;
+                    item._due = now - estd::chrono::milliseconds(10);
+                    dataport.retry().add_to_retry(&item);
+                }
+
+                // all come due at once, so all go out in the same pass
+                REQUIRE(dataport.process_retry() == 3);
+                REQUIRE(!dataport.retry().next_deadline());
+
+                for(item_type& item : items)
+                    REQUIRE(dataport.datapump().dequeue_to_transport() == &item);
+
+                REQUIRE(!dataport.datapump().to_transport_ready());
+                REQUIRE(dataport.process_retry() == 0);
+            }
+            SECTION("retry drain through process")
+            {
+                typedef datapump_type::item_type item_type;
+                typedef datapump_type::clock_type clock_type;
+
+                static int sent;
+                item_type items[3];
+
+                sent = 0;
+
+                dataport.notifier = [](state_type state, context_type* context)
+                {
+                    if(state == state_type::TransportOutDequeued) ++sent;
+                };
+
+                for(item_type& item : items)
+                {
+                    item.pbuf = CON_0;
+                    item._due = clock_type::now() - estd::chrono::milliseconds(10);
+                    dataport.retry().add_to_retry(&item);
+                }
+
+                dataport.process();
+
+                // every due retry reached transport in the one pass, and went back
+                // into retry list awaiting its ACK
+                REQUIRE(sent == 3);
+                REQUIRE(!dataport.datapump().to_transport_ready());
+
+                for(item_type& item : items)
+                    REQUIRE(dataport.retry().remove_from_retry(&item));
+            }
+            SECTION("retry gives up")
+            {
+                typedef datapump_type::item_type item_type;
+                typedef datapump_type::clock_type clock_type;
+
+                static item_type* given_up[2];
+                static int given_up_count;
+                item_type items[2];
+
+                given_up_count = 0;
+
+                dataport.notifier = [](state_type state, context_type* context)
+                {
+                    if(state == state_type::RetryDequeued)
+                        given_up[given_up_count++] = context->item;
+                };
+
+                for(item_type& item : items)
+                {
+                    item.pbuf = CON_0;
+                    // initial send plus MAX_RETRANSMIT retransmissions, last of which
+                    // has now gone unanswered for its whole timeout
+                    item._counter = Rfc7252RetryTiming::max_retransmit + 1;
+                    item._due = clock_type::now() - estd::chrono::milliseconds(10);
+                    dataport.retry().add_to_retry(&item);
+                }
+
+                REQUIRE(dataport.process_retry() == 0);
+                // both given up in the same pass, and listener hears of each
+                REQUIRE(given_up_count == 2);
+                REQUIRE(given_up[0] != given_up[1]);
+                REQUIRE((given_up[0] == &items[0] || given_up[0] == &items[1]));
+                REQUIRE((given_up[1] == &items[0] || given_up[1] == &items[1]));
+                REQUIRE(!dataport.datapump().to_transport_ready());
+                REQUIRE(!dataport.retry().next_deadline());
+            }
+            SECTION("pool exhausted")
+            {
+                typedef DatapumpWithRetry2<const char*, int, SyntheticRetry,
+                    SyntheticRetry::RetryItem, Datapump2FixedPoolPolicy<1> > small_datapump_type;
+                typedef Dataport2<small_datapump_type> small_dataport_type;
+
+                small_dataport_type small_dataport;
+
+                small_dataport.notifier = [](small_dataport_type::State state,
+                    small_dataport_type::NotifyContext* context)
+                {
+                    auto user = (Context*) context->user;
+
+                    if(state == small_dataport_type::TransportInPoolExhausted)
+                    {
+                        // pbuf comes back to us so that we may free it
+                        REQUIRE(context->buf_addr.addr == 1);
+                        user->state_progression_counter++;
+                    }
+                    else if(state == small_dataport_type::TransportOutPoolExhausted)
+                    {
+                        REQUIRE(context->buf_addr.addr >= 2);
+                        user->state_progression_counter += 10;
+                    }
+                };
+
+                REQUIRE(small_dataport.received_from_transport(ACK_0, 0, &context) == PoolOK);
+                REQUIRE(small_dataport.received_from_transport(ACK_1, 1, &context) == PoolExhausted);
+                REQUIRE(context.state_progression_counter == 1);
+
+                // back to back failures each get their own event
+                REQUIRE(small_dataport.received_from_transport(ACK_1, 1, &context) == PoolExhausted);
+                REQUIRE(context.state_progression_counter == 2);
+
+                const char* pbuf = CON_0;
+
+                REQUIRE(small_dataport.send_to_transport(pbuf, 2, &context) == PoolExhausted);
+                REQUIRE(small_dataport.send_to_transport(pbuf, 3, &context) == PoolExhausted);
+                REQUIRE(context.state_progression_counter == 22);
+            }
         }
     }
 }
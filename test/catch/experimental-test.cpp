@@ -4,6 +4,7 @@
 #include <embr/netbuf-dynamic.h>
 #include <embr/netbuf-reader.h>
 #include <embr/exp/netbuf-alloc.h>
+#include <embr/exp/hash-index.h>
 
 #include <estd/string.h>
 #include <estd/string_view.h>
@@ -13,11 +14,14 @@
 #include <embr/streambuf.hpp>
 #include <estd/sstream.h>
 
+#include <random>
+#include <vector>
+
 using namespace embr::experimental;
 
-template <class TTransport, class TRetryPolicyImpl, class TTimer>
-std::allocator<typename RetryManager<TTransport, TRetryPolicyImpl, TTimer>::QueuedItem>
-        RetryManager<TTransport, TRetryPolicyImpl, TTimer>::stub;
+template <class TTransport, class TRetryPolicyImpl, class TTimer, size_t index_slots>
+std::allocator<typename RetryManager<TTransport, TRetryPolicyImpl, TTimer, index_slots>::QueuedItem>
+        RetryManager<TTransport, TRetryPolicyImpl, TTimer, index_slots>::stub;
 
 template <class TAllocator>
 class test_string : public estd::basic_string<
@@ -126,6 +130,11 @@ TEST_CASE("experimental test", "[experimental]")
             {
                 return 100;
             }
+
+            bool match(int incoming, int outgoing)
+            {
+                return incoming == outgoing;
+            }
         };
 
 
@@ -134,9 +143,17 @@ TEST_CASE("experimental test", "[experimental]")
             typedef unsigned timebase_type;
             typedef int handle_type;
 
+            handle_type created = 0;
+            int destroyed = 0;
+
             handle_type create(timebase_type expiry, void* arg)
             {
-                return 0;
+                return created++;
+            }
+
+            void destroy(handle_type)
+            {
+                ++destroyed;
             }
         };
 
@@ -152,5 +169,97 @@ TEST_CASE("experimental test", "[experimental]")
 
         // FIX: In its current state, this generates a memory leak since send does a 'new'
         rm.send(fake_endpoint, *sb, 0);
+
+        SECTION("reply matching")
+        {
+            rm.send(fake_endpoint, *sb, 1);
+            rm.send(8, *sb, 1);
+
+            REQUIRE(rm.load_factor() == 3.0f / 32);
+
+            auto item = rm.evaluate_received(8, 1);
+
+            REQUIRE(item != NULLPTR);
+            REQUIRE(item->endpoint == 8);
+            REQUIRE(item->manager == &rm);
+            REQUIRE(rm.evaluate_received(9, 1) == NULLPTR);
+            REQUIRE(rm.evaluate_received(8, 2) == NULLPTR);
+
+            REQUIRE(rm.remove(item));
+            // timer stopped along with it, so nothing further fires for item
+            REQUIRE(rm.timer_impl.destroyed == 1);
+
+            REQUIRE(rm.evaluate_received(8, 1) == NULLPTR);
+            REQUIRE(rm.evaluate_received(fake_endpoint, 1) != NULLPTR);
+            REQUIRE(rm.load_factor() == 2.0f / 32);
+
+            // second removal is a no-op, and mustn't disturb unindexed tally
+            REQUIRE(!rm.remove(item));
+            REQUIRE(rm.unindexed == 0);
+            REQUIRE(rm.load_factor() == 2.0f / 32);
+            REQUIRE(rm.timer_impl.destroyed == 1);
+
+            auto acked = rm.acknowledge(fake_endpoint, 1);
+
+            REQUIRE(acked != NULLPTR);
+            REQUIRE(acked->key == 1);
+            REQUIRE(rm.timer_impl.destroyed == 2);
+            REQUIRE(rm.acknowledge(fake_endpoint, 1) == NULLPTR);
+            REQUIRE(rm.load_factor() == 1.0f / 32);
+        }
+    }
+    SECTION("HashIndex")
+    {
+        struct Item
+        {
+            int key;
+            bool indexed = false;
+        };
+
+        const int count = 100;
+        Item items[count];
+        HashIndex<Item, 64> index;
+        std::mt19937 r(0);
+
+        // deliberately poor hash so that probe runs collide and wrap around
+        auto hash = [](int key) { return (uint32_t)(key % 16) * 4 + 60; };
+
+        for(int i = 0; i < count; i++) items[i].key = i;
+
+        REQUIRE(index.capacity() == 63);
+
+        for(int round = 0; round < 20000; round++)
+        {
+            Item& item = items[r() % count];
+            auto match = [&](const Item* candidate) { return candidate->key == item.key; };
+
+            if(item.indexed)
+            {
+                REQUIRE(index.find(hash(item.key), match) == &item);
+                REQUIRE(index.remove(hash(item.key), match) == &item);
+                item.indexed = false;
+            }
+            else if(index.insert(&item, hash(item.key)))
+                item.indexed = true;
+            else
+                REQUIRE(index.size() == index.capacity());
+
+            REQUIRE(index.find(hash(item.key), match) == (item.indexed ? &item : NULLPTR));
+        }
+
+        size_t indexed = 0;
+
+        for(Item& item : items)
+        {
+            if(!item.indexed) continue;
+
+            indexed++;
+            REQUIRE(index.erase(&item, hash(item.key)));
+            REQUIRE(!index.erase(&item, hash(item.key)));
+        }
+
+        REQUIRE(indexed > 0);
+        REQUIRE(index.size() == 0);
+        REQUIRE(index.load_factor() == 0);
     }
 }
@@ -0,0 +1,181 @@
+#include <catch.hpp>
+
+#include <embr/format.h>
+#include <embr/netbuf-static.h>
+#include <embr/netbuf-dynamic.h>
+#include <embr/netbuf-writer.h>
+#include <embr/streambuf.h>
+
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <random>
+#include <string>
+
+using namespace embr;
+
+namespace {
+
+template <class T>
+std::string to_decimal(T value)
+{
+    char buf[internal::max_decimal_chars];
+
+    return std::string(buf, internal::to_decimal(buf, value));
+}
+
+// reassembles netbuf chain contents
+template <class TNetBuf>
+std::string contents(TNetBuf& nb, size_t size)
+{
+    std::string s;
+
+    nb.reset();
+
+    do
+    {
+        size_t sz = nb.size() < size ? nb.size() : size;
+        s.append(static_cast<const char*>(nb.data()), sz);
+        size -= sz;
+    }
+    while(size > 0 && nb.next());
+
+    return s;
+}
+
+}
+
+TEST_CASE("format test", "[format]")
+{
+    SECTION("integers")
+    {
+        REQUIRE(to_decimal(0) == "0");
+        REQUIRE(to_decimal(7) == "7");
+        REQUIRE(to_decimal(10) == "10");
+        REQUIRE(to_decimal(-99) == "-99");
+        REQUIRE(to_decimal(100) == "100");
+        REQUIRE(to_decimal(INT_MIN) == "-2147483648");
+        REQUIRE(to_decimal(UINT_MAX) == "4294967295");
+        REQUIRE(to_decimal(LLONG_MIN) == "-9223372036854775808");
+        REQUIRE(to_decimal(ULLONG_MAX) == "18446744073709551615");
+
+        std::mt19937_64 r(0);
+        char expected[32];
+
+        for(int i = 0; i < 10000; i++)
+        {
+            // shift so that all digit counts get exercised
+            long long v = (long long)r() >> (r() % 64);
+
+            snprintf(expected, sizeof(expected), "%lld", v);
+
+            REQUIRE(to_decimal(v) == expected);
+        }
+    }
+    SECTION("floating point")
+    {
+        REQUIRE(to_decimal(0.0) == "0");
+        REQUIRE(to_decimal(-0.0) == "-0");
+        REQUIRE(to_decimal(1.0) == "1");
+        REQUIRE(to_decimal(0.1) == "0.1");
+        REQUIRE(to_decimal(-123.456) == "-123.456");
+        REQUIRE(to_decimal(0.000001) == "0.000001");
+        REQUIRE(to_decimal(1e-7) == "1e-7");
+        REQUIRE(to_decimal(1e21) == "1e21");
+        REQUIRE(to_decimal(5e-324) == "5e-324");
+        REQUIRE(to_decimal(1.7976931348623157e308) == "1.7976931348623157e308");
+        REQUIRE(to_decimal(0.1f) == "0.1");
+        REQUIRE(to_decimal(3.4028235e38f) == "3.4028235e38");
+        REQUIRE(to_decimal(1.0 / 0.0) == "inf");
+
+        SECTION("round trip")
+        {
+            std::mt19937_64 r(0);
+
+            for(int i = 0; i < 100000; i++)
+            {
+                uint64_t bits = r();
+                double v;
+
+                memcpy(&v, &bits, sizeof(v));
+
+                if(v != v || v - v != 0) continue;
+
+                std::string s = to_decimal(v);
+
+                REQUIRE(s.size() < internal::max_decimal_chars);
+                REQUIRE(strtod(s.c_str(), NULLPTR) == v);
+            }
+        }
+    }
+    SECTION("writer")
+    {
+        SECTION("fits in chunk")
+        {
+            mem::layer1::NetBuf<64> netbuf;
+            mem::NetBufWriter<mem::layer1::NetBuf<64>&> writer(netbuf);
+
+            REQUIRE(experimental::write_decimal(writer, -42));
+            writer << (uint8_t)' ';
+            REQUIRE(experimental::write_decimal(writer, 2.5));
+            REQUIRE(mem::experimental::itoa(writer, -255, 16));
+
+            REQUIRE(contents(netbuf, 10) == "-42 2.5-ff");
+        }
+        SECTION("itoa base out of range")
+        {
+            mem::layer1::NetBuf<64> netbuf;
+            mem::NetBufWriter<mem::layer1::NetBuf<64>&> writer(netbuf);
+
+            REQUIRE(!mem::experimental::itoa(writer, 5, 0));
+            REQUIRE(!mem::experimental::itoa(writer, 5, 1));
+            REQUIRE(!mem::experimental::itoa(writer, 5, 37));
+            REQUIRE(!mem::experimental::itoa(writer, 5, -16));
+
+            // nothing was written
+            REQUIRE(writer.buffer().size() == 64);
+
+            REQUIRE(mem::experimental::itoa(writer, 35, 36));
+            REQUIRE(contents(netbuf, 1) == "z");
+        }
+        SECTION("out of room")
+        {
+            mem::layer1::NetBuf<4> netbuf;
+            mem::NetBufWriter<mem::layer1::NetBuf<4>&> writer(netbuf);
+
+            REQUIRE(experimental::write_decimal(writer, 123));
+            REQUIRE(!experimental::write_decimal(writer, 45));
+        }
+        SECTION("spills across chunks")
+        {
+            mem::experimental::NetBufDynamic<> netbuf;
+            mem::NetBufWriter<decltype(netbuf)&, mem::experimental::ExactGrowthPolicy> writer(netbuf);
+
+            writer.reserve(125);
+            memset(writer.buffer().data(), 'x', 125);
+            writer.commit(125);
+
+            REQUIRE(experimental::write_decimal(writer, 1234567));
+            REQUIRE(netbuf.chunk_count() == 2);
+            REQUIRE(experimental::write_decimal(writer, 0.25));
+
+            REQUIRE(contents(netbuf, 136) == std::string(125, 'x') + "12345670.25");
+        }
+    }
+    SECTION("streambuf")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type netbuf;
+        mem::out_netbuf_streambuf<char, netbuf_type&> out(netbuf);
+        const std::string filler(126, 'y');
+
+        out.sputn(filler.data(), filler.size());
+
+        REQUIRE(experimental::write_decimal(out, -1e-10));
+        REQUIRE(experimental::write_decimal(out, 99u));
+
+        REQUIRE(contents(netbuf, out.absolute_pos()) == filler + "-1e-1099");
+    }
+}
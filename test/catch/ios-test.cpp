@@ -3,6 +3,7 @@
 #include <embr/streambuf.h>
 #include <embr/netbuf-static.h>
 #include <embr/netbuf-dynamic.h>
+#include <embr/checksum.h>
 
 #include <estd/string.h>
 #include <estd/ostream.h>
@@ -19,6 +20,25 @@ using namespace estd;
 #include <estd/internal/istream_runtimearray.hpp>
 #include <estd/internal/ostream_basic_string.hpp>
 
+// stands in for a pbuf chain without FEATURE_EMBR_PBUF_CHAIN_EXP: chains forward,
+// but has no way back to its first chunk
+struct forward_only_netbuf : mem::experimental::NetBufDynamic<>
+{
+    void reset() {}
+};
+
+namespace embr { namespace mem {
+
+template <>
+struct NetBufTraits<forward_only_netbuf>
+{
+    static CONSTEXPR bool can_chain() { return true; }
+    static CONSTEXPR bool can_expand() { return true; }
+    static CONSTEXPR bool can_reset() { return false; }
+};
+
+}}
+
 TEST_CASE("iostreams", "[ios]")
 {
     // FIX: constructor botches for some reason on that one
@@ -62,6 +82,385 @@ TEST_CASE("iostreams", "[ios]")
             REQUIRE(sb.pbase() == (char*)nb.data());
         }
     }
+    SECTION("output netbuf+streambuf with running digest")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type nb_dynamic;
+        experimental::InternetChecksum expected;
+        experimental::Crc32c expected_crc;
+
+        mem::out_netbuf_streambuf<char, netbuf_type&, std::char_traits<char>,
+            experimental::InternetChecksum> sb(nb_dynamic);
+        mem::out_netbuf_streambuf<char, mem::layer1::NetBuf<32>&, std::char_traits<char>,
+            experimental::Crc32c> sb_crc(nb);
+
+        // odd length, spanning more than one chunk
+        for(int i = 0; i < 4; i++)
+        {
+            sb.sputn(test_str.data(), test_str.size());
+            expected.update(test_str.data(), test_str.size());
+        }
+
+        REQUIRE(nb_dynamic.chunk_count() == 2);
+        REQUIRE(sb.digest().value() == expected.value());
+
+        // only bytes which actually fit are digested
+        int written = sb_crc.sputn(test_str.data(), test_str.size());
+
+        REQUIRE(written == 32);
+        expected_crc.update(test_str.data(), written);
+        REQUIRE(sb_crc.digest().value() == expected_crc.value());
+
+        // digest state only takes up space when one is specified
+        REQUIRE(sizeof(mem::out_netbuf_streambuf<char, netbuf_type&>) <
+                sizeof(sb));
+    }
+    SECTION("absolute position across chain")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type nb_dynamic;
+        mem::out_netbuf_streambuf<char, netbuf_type&> out(nb_dynamic);
+
+        for(int i = 0; i < 4; i++)
+        {
+            out.sputn(test_str.data(), test_str.size());
+
+            REQUIRE(out.absolute_pos() == test_str.size() * (i + 1));
+        }
+
+        REQUIRE(nb_dynamic.chunk_count() == 2);
+
+        nb_dynamic.reset();
+
+        const int total = nb_dynamic.total_size();
+        mem::in_netbuf_streambuf<char, netbuf_type&> in(nb_dynamic);
+        char buf[150];
+
+        REQUIRE(in.in_avail() == total);
+
+        in.sgetn(buf, 150);
+
+        // now into second chunk
+        REQUIRE(in.absolute_pos() == 150);
+        REQUIRE(in.in_avail() == total - 150);
+        REQUIRE(in.pubseekoff(0, estd::ios_base::cur, estd::ios_base::in) == 150);
+
+        in.sbumpc();
+
+        REQUIRE(in.in_avail() == total - 151);
+    }
+    SECTION("seeking across chain")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+        typedef estd::ios_base ios_base;
+
+        netbuf_type nb_dynamic;
+        mem::out_netbuf_streambuf<char, netbuf_type&> out(nb_dynamic);
+
+        // reserve a length prefix, to be patched after the payload is written
+        out.sputn("??", 2);
+
+        for(int i = 0; i < 4; i++)
+            out.sputn(test_str.data(), test_str.size());
+
+        const int written = 2 + test_str.size() * 4;
+
+        REQUIRE(nb_dynamic.chunk_count() == 2);
+        REQUIRE(out.pubseekoff(0, ios_base::cur, ios_base::out) == written);
+
+        // backward, across chunks
+        REQUIRE(out.pubseekoff(0, ios_base::beg, ios_base::out) == 0);
+        out.sputn("OK", 2);
+
+        // forward again, across chunks
+        REQUIRE(out.pubseekoff(written - 3, ios_base::cur, ios_base::out) == written - 1);
+        out.sputn("!", 1);
+
+        // past end of chain fails, leaving position alone
+        REQUIRE(out.pubseekoff(1, ios_base::end, ios_base::out) == -1);
+        REQUIRE(out.absolute_pos() == written);
+
+        nb_dynamic.reset();
+
+        mem::in_netbuf_streambuf<char, netbuf_type&> in(nb_dynamic);
+        char buf[4];
+
+        REQUIRE(in.sgetn(buf, 2) == 2);
+        REQUIRE(memcmp(buf, "OK", 2) == 0);
+
+        REQUIRE(in.pubseekoff(written - 1, ios_base::beg, ios_base::in) == written - 1);
+        REQUIRE(in.sbumpc() == '!');
+
+        // back into first chunk
+        REQUIRE(in.pubseekoff(-(written - 1), ios_base::cur, ios_base::in) == 1);
+        REQUIRE(in.sbumpc() == 'K');
+        REQUIRE(in.sbumpc() == test_str[0]);
+    }
+    SECTION("seeking a netbuf which can't reset")
+    {
+        typedef estd::ios_base ios_base;
+
+        forward_only_netbuf nb_forward;
+        mem::out_netbuf_streambuf<char, forward_only_netbuf&> out(nb_forward);
+
+        // 176 characters across two 128 byte chunks
+        for(int i = 0; i < 4; i++)
+            out.sputn(test_str.data(), test_str.size());
+
+        // no reset(), yet first chunk was remembered on the way past it
+        REQUIRE(out.pubseekoff(0, ios_base::beg, ios_base::out) == 0);
+        out.sputn("OK", 2);
+
+        REQUIRE(out.pubseekpos(174, ios_base::out) == 174);
+        out.sputn("!!", 2);
+
+        nb_forward.NetBufDynamic::reset();
+
+        mem::in_netbuf_streambuf<char, forward_only_netbuf&> in(nb_forward);
+
+        // forward, into second chunk
+        REQUIRE(in.pubseekoff(130, ios_base::beg, ios_base::in) == 130);
+        REQUIRE(in.sbumpc() == test_str[130 - 88]);
+
+        // back again, into first chunk
+        REQUIRE(in.pubseekoff(-130, ios_base::cur, ios_base::in) == 1);
+        REQUIRE(in.sbumpc() == 'K');
+
+        REQUIRE(in.pubseekpos(174, ios_base::in) == 174);
+        REQUIRE(in.sbumpc() == '!');
+
+        nb_forward.NetBufDynamic::reset();
+
+        mem::in_netbuf_streambuf<char, forward_only_netbuf&> in2(nb_forward);
+        char bounce[8];
+
+        REQUIRE(in2.pubseekpos(124, ios_base::in) == 124);
+
+        // straddles into second chunk, yet peeking still leaves us in first
+        estd::span<char> s = in2.peek_contiguous(8, estd::span<char>(bounce, sizeof(bounce)));
+
+        REQUIRE(s.data() == bounce);
+        REQUIRE(memcmp(bounce, test_str.data() + (124 - 88), 8) == 0);
+        REQUIRE(in2.absolute_pos() == 124);
+        REQUIRE(in2.sbumpc() == test_str[124 - 88]);
+    }
+    SECTION("seeking back along a long chain")
+    {
+        typedef estd::ios_base ios_base;
+
+        forward_only_netbuf nb_forward;
+        mem::out_netbuf_streambuf<char, forward_only_netbuf&> out(nb_forward);
+
+        // 40 chunks, more than the seek index holds, so it has to thin out
+        const int total = 128 * 40;
+
+        for(int i = 0; i < total; i++)
+            out.sputc(char(i % 101));
+
+        REQUIRE(nb_forward.chunk_count() == 40);
+
+        nb_forward.NetBufDynamic::reset();
+
+        mem::in_netbuf_streambuf<char, forward_only_netbuf&> in(nb_forward);
+
+        REQUIRE(in.pubseekpos(total - 1, ios_base::in) == total - 1);
+
+        for(int p = total - 2; p >= 0; p -= 97)
+        {
+            REQUIRE(in.pubseekpos(p, ios_base::in) == p);
+            REQUIRE(in.sbumpc() == char(p % 101));
+        }
+
+        // on a chunk boundary
+        REQUIRE(in.pubseekpos(128 * 20, ios_base::in) == 128 * 20);
+        REQUIRE(in.sbumpc() == char((128 * 20) % 101));
+        REQUIRE(in.pubseekpos(0, ios_base::in) == 0);
+        REQUIRE(in.sbumpc() == 0);
+    }
+    SECTION("reserve/commit")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type nb_dynamic;
+        mem::out_netbuf_streambuf<char, netbuf_type&, std::char_traits<char>,
+            experimental::InternetChecksum> out(nb_dynamic);
+        experimental::InternetChecksum expected;
+
+        estd::span<char> s = out.reserve(100);
+
+        REQUIRE(s.size() == 128);
+
+        memcpy(s.data(), test_str.data(), test_str.size());
+        out.commit(test_str.size());
+        expected.update(test_str.data(), test_str.size());
+
+        REQUIRE(out.absolute_pos() == test_str.size());
+        REQUIRE(out.digest().value() == expected.value());
+
+        // would straddle chunks, so caller must fall back to sputn
+        REQUIRE(out.reserve(100).size() == 0);
+
+        out.sputn(test_str.data(), test_str.size());
+        out.sputn(test_str.data(), 128 - 2 * test_str.size() - 4);
+
+        // committing more than current chunk holds stops at its end
+        s = out.reserve(4);
+
+        REQUIRE(s.size() == 4);
+        REQUIRE(out.commit(10) == 4);
+        REQUIRE(out.pptr() == out.epptr());
+
+        // current chunk full, so onto a new one
+        s = out.reserve(16);
+
+        REQUIRE(s.size() >= 16);
+        REQUIRE(nb_dynamic.chunk_count() == 2);
+        REQUIRE(out.absolute_pos() == 128);
+    }
+    SECTION("reserve/commit, expanding in place")
+    {
+        typedef mem::layer2::NetBuf<64> netbuf_type;
+        typedef estd::ios_base ios_base;
+
+        netbuf_type nb_linear;
+        mem::out_netbuf_streambuf<char, netbuf_type&> out(nb_linear);
+
+        // grows to fit, then gives back what wasn't committed
+        estd::span<char> s = out.reserve(20);
+
+        REQUIRE(s.size() == 20);
+        REQUIRE(nb_linear.size() == 20);
+
+        memcpy(s.data(), "123", 3);
+        out.commit(3);
+
+        REQUIRE(nb_linear.size() == 3);
+
+        // repeatedly, size tracks only what was committed
+        for(int i = 0; i < 5; i++)
+        {
+            s = out.reserve(20);
+            memcpy(s.data(), "45", 2);
+            out.commit(2);
+        }
+
+        REQUIRE(nb_linear.size() == 13);
+
+        // space which was already there is left alone
+        REQUIRE(out.pubseekpos(0, ios_base::out) == 0);
+        s = out.reserve(4);
+
+        REQUIRE(s.size() == 13);
+
+        out.commit(1);
+
+        REQUIRE(nb_linear.size() == 13);
+        REQUIRE(memcmp(nb_linear.data(), "1234545454545", 13) == 0);
+    }
+    SECTION("peek/consume")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type nb_dynamic;
+        mem::out_netbuf_streambuf<char, netbuf_type&> out(nb_dynamic);
+
+        // 176 characters across two 128 byte chunks
+        for(int i = 0; i < 4; i++)
+            out.sputn(test_str.data(), test_str.size());
+
+        nb_dynamic.reset();
+
+        mem::in_netbuf_streambuf<char, netbuf_type&> in(nb_dynamic);
+        char bounce[16];
+
+        estd::span<char> s = in.peek_contiguous(3);
+
+        // borrowed straight from the chunk
+        REQUIRE(s.data() == (char*)nb_dynamic.data());
+        REQUIRE(s.size() == 128);
+        REQUIRE(memcmp(s.data(), "the", 3) == 0);
+
+        REQUIRE(in.consume(4));
+        in.pubseekoff(120, estd::ios_base::beg, estd::ios_base::in);
+
+        // 8 characters left in this chunk, so straddles
+        REQUIRE(in.peek_contiguous(10).size() == 0);
+
+        s = in.peek_contiguous(10, estd::span<char>(bounce, sizeof(bounce)));
+
+        REQUIRE(s.data() == bounce);
+        REQUIRE(s.size() == 10);
+        REQUIRE(memcmp(bounce, test_str.data() + (120 - 88), 10) == 0);
+        // peeking doesn't move us
+        REQUIRE(in.absolute_pos() == 120);
+
+        REQUIRE(in.consume(10));
+
+        REQUIRE(in.absolute_pos() == 130);
+        REQUIRE(in.sbumpc() == test_str[130 - 88]);
+
+        // past end of chain
+        REQUIRE(!in.consume(200));
+        REQUIRE(in.absolute_pos() == 131);
+    }
+    SECTION("network order integers")
+    {
+        typedef mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type nb_dynamic;
+        mem::out_netbuf_streambuf<char, netbuf_type&> out(nb_dynamic);
+        char padding[126] = {};
+
+        out.sputn(padding, sizeof(padding));
+
+        // first one straddles 128 byte chunk boundary
+        REQUIRE(out.write_u32(0x12345678));
+        REQUIRE(out.write_u16(0xABCD));
+        REQUIRE(out.write_u64(0x0102030405060708));
+        REQUIRE(nb_dynamic.chunk_count() == 2);
+
+        nb_dynamic.reset();
+
+        mem::in_netbuf_streambuf<char, netbuf_type&> in(nb_dynamic);
+        uint16_t v16;
+        uint32_t v32;
+        uint64_t v64;
+
+        in.pubseekoff(sizeof(padding), estd::ios_base::beg, estd::ios_base::in);
+
+        REQUIRE(in.read_u32(v32));
+        REQUIRE(v32 == 0x12345678);
+        REQUIRE(in.read_u16(v16));
+        REQUIRE(v16 == 0xABCD);
+        REQUIRE(in.read_u64(v64));
+        REQUIRE(v64 == 0x0102030405060708);
+        REQUIRE(in.absolute_pos() == sizeof(padding) + 14);
+    }
+    SECTION("input streambuf over contiguous netbuf")
+    {
+        typedef mem::layer1::NetBuf<32> netbuf_type;
+
+        REQUIRE(mem::internal::netbuf_is_contiguous<netbuf_type>::value);
+        REQUIRE(!mem::internal::netbuf_is_contiguous<mem::experimental::NetBufDynamic<> >::value);
+
+        memcpy(nb.data(), test_str.data(), 32);
+
+        mem::in_netbuf_streambuf<char, netbuf_type&> sb(nb);
+        char buf[64];
+
+        REQUIRE(sb.sbumpc() == 't');
+        REQUIRE(sb.sgetc() == 'h');
+
+        // asking for more than is present only yields what is present
+        int count = sb.sgetn(buf, sizeof(buf));
+
+        REQUIRE(count == 31);
+        REQUIRE(memcmp(buf, test_str.data() + 1, 31) == 0);
+        REQUIRE(sb.sgetc() == std::char_traits<char>::eof());
+        REQUIRE(sb.sgetn(buf, sizeof(buf)) == 0);
+    }
     SECTION("list of NetBufDynamicChunk")
     {
         typedef mem::experimental::NetBufDynamicChunk Chunk;
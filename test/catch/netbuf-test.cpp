@@ -2,9 +2,21 @@
 
 #include <embr/netbuf-static.h>
 #include <embr/netbuf-dynamic.h>
+#include <embr/exp/netbuf-slab.h>
+#include <embr/netbuf-gather.h>
 
 using namespace embr;
 
+namespace {
+
+// omits should_reclaim and expand_size, so NetBufDynamic falls back on default policy's
+struct MinimalDynamicPolicy
+{
+    CONSTEXPR int minimum_allocation_size() const { return 128; }
+};
+
+}
+
 TEST_CASE("netbuf")
 {
     SECTION("static")
@@ -44,6 +56,31 @@ TEST_CASE("netbuf")
             nb.shrink_experimental(64);
 
             REQUIRE(nb.size() == 64);
+            // trimmed well past reclaim threshold, so chunk was relocated
+            // into a right-sized allocation
+            REQUIRE(nb.chunks.front().capacity == 64);
+        }
+        SECTION("shrink small")
+        {
+            uint8_t* d = (uint8_t*)nb.data();
+
+            d[0] = 7;
+
+            nb.shrink_experimental(500);
+
+            // not enough trimmed to bother relocating
+            REQUIRE(nb.size() == 500);
+            REQUIRE(nb.chunks.front().capacity == 512);
+            REQUIRE(nb.data() == d);
+        }
+        SECTION("shrink to 0")
+        {
+            nb.shrink_experimental(0);
+
+            REQUIRE(nb.size() == 0);
+            REQUIRE(nb.total_size() == 0);
+            REQUIRE(nb.chunk_count() == 0);
+            REQUIRE(nb.chunks.empty());
         }
         SECTION("shrink exact")
         {
@@ -56,12 +93,14 @@ TEST_CASE("netbuf")
             nb.expand(128, true);
 
             REQUIRE(nb.total_size() == 512 + 128);
+            REQUIRE(nb.chunk_count() == 2);
 
             SECTION("shrink to 128")
             {
                 nb.shrink_experimental(128);
 
                 REQUIRE(nb.total_size() == 128);
+                REQUIRE(nb.chunk_count() == 1);
             }
             SECTION("shrink to 600")
             {
@@ -69,6 +108,290 @@ TEST_CASE("netbuf")
 
                 REQUIRE(nb.total_size() == 600);
             }
+            SECTION("expand while positioned earlier in chain")
+            {
+                nb.reset();
+
+                REQUIRE(nb.size() == 512);
+
+                // appends after the true tail, not after current, so
+                // nothing gets orphaned
+                nb.expand(256, false);
+
+                REQUIRE(nb.size() == 512);
+                REQUIRE(nb.chunk_count() == 3);
+                REQUIRE(nb.total_size() == 512 + 128 + 256);
+
+                REQUIRE(nb.next());
+                REQUIRE(nb.size() == 128);
+                REQUIRE(nb.next());
+                REQUIRE(nb.size() == 256);
+                REQUIRE(nb.last());
+            }
+            SECTION("shrink relocates and preserves data")
+            {
+                uint8_t* d = (uint8_t*)nb.data();
+
+                d[0] = 1; d[1] = 2;
+
+                nb.shrink_experimental(512 + 2);
+
+                REQUIRE(nb.total_size() == 512 + 2);
+                REQUIRE(nb.size() == 2);
+
+                d = (uint8_t*)nb.data();
+
+                REQUIRE(d[0] == 1);
+                REQUIRE(d[1] == 2);
+            }
+        }
+    }
+    SECTION("dynamic, minimal policy")
+    {
+        mem::experimental::NetBufDynamic<std::allocator<uint8_t>, MinimalDynamicPolicy> nb;
+
+        nb.expand(512, true);
+
+        // exactly what was asked for
+        REQUIRE(nb.size() == 512);
+
+        // not enough trimmed to bother relocating
+        nb.shrink_experimental(500);
+
+        REQUIRE(nb.chunks.front().capacity == 512);
+
+        nb.shrink_experimental(64);
+
+        REQUIRE(nb.size() == 64);
+        REQUIRE(nb.chunks.front().capacity == 64);
+    }
+}
+
+TEST_CASE("netbuf growth policy")
+{
+    using namespace mem::experimental;
+
+    SECTION("geometric")
+    {
+        NetBufDynamic<std::allocator<uint8_t>,
+                      NetBufDynamicPolicy<GeometricGrowthPolicy<128, 1024> > > nb;
+
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 128);
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 256);
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 512);
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 1024);
+        // capped
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 1024);
+        // but never less than requested
+        nb.expand(3000, true);
+        REQUIRE(nb.size() == 3000);
+    }
+    SECTION("fixed (MTU)")
+    {
+        NetBufDynamic<std::allocator<uint8_t>,
+                      NetBufDynamicPolicy<FixedGrowthPolicy<1460> > > nb;
+
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 1460);
+        nb.expand(2000, true);
+        REQUIRE(nb.size() == 2000);
+    }
+    SECTION("hint")
+    {
+        NetBufDynamic<std::allocator<uint8_t>,
+                      NetBufDynamicPolicy<HintGrowthPolicy> > nb;
+
+        nb.expand(300, true);
+        nb.expand(10, true);
+        REQUIRE(nb.size() == 300);
+    }
+}
+
+// stand-in for POSIX struct iovec
+struct test_iovec
+{
+    void* iov_base;
+    size_t iov_len;
+};
+
+TEST_CASE("netbuf gather view")
+{
+    using namespace mem::experimental;
+
+    SECTION("layer1")
+    {
+        mem::layer1::NetBuf<64> nb;
+        NetBufGatherView<4> view(nb);
+
+        REQUIRE(view.size() == 1);
+        REQUIRE(view.total_size() == 64);
+        REQUIRE(view[0].data() == nb.data());
+    }
+    SECTION("layer2")
+    {
+        mem::layer2::NetBuf<64> nb;
+        NetBufGatherView<4> view;
+
+        // nothing written yet, so no segments
+        REQUIRE(view.gather(nb));
+        REQUIRE(view.empty());
+
+        nb.expand(10, true);
+        view.gather(nb);
+
+        REQUIRE(view.size() == 1);
+        REQUIRE(view.total_size() == 10);
+    }
+    SECTION("dynamic, no chunks")
+    {
+        NetBufDynamic<> nb;
+        NetBufGatherView<4> view;
+
+        REQUIRE(view.gather(nb));
+        REQUIRE(view.empty());
+        REQUIRE(view.total_size() == 0);
+    }
+    SECTION("dynamic")
+    {
+        NetBufDynamic<> nb;
+
+        nb.expand(200, true);
+        nb.expand(300, true);
+        nb.expand(400, true);
+
+        void* last_data = nb.data();
+
+        SECTION("whole chain")
+        {
+            NetBufGatherView<4> view(nb);
+
+            REQUIRE(view.size() == 3);
+            REQUIRE(!view.truncated());
+            REQUIRE(view.total_size() == 900);
+            REQUIRE(view[1].size() == 300);
+            REQUIRE(view[2].data() == last_data);
+
+            // cursor is back where we left it
+            REQUIRE(nb.data() == last_data);
+
+            test_iovec iov[4];
+
+            REQUIRE(view.export_to(iov) == 3);
+            REQUIRE(iov[0].iov_len == 200);
+            REQUIRE(iov[2].iov_base == last_data);
+        }
+        SECTION("truncated")
+        {
+            NetBufGatherView<2, uint8_t> view;
+
+            REQUIRE(!view.gather(nb));
+            REQUIRE(view.truncated());
+            REQUIRE(view.size() == 2);
+            REQUIRE(view.total_size() == 500);
+            REQUIRE(nb.data() == last_data);
+        }
+        SECTION("from middle of chain")
+        {
+            nb.reset();
+            nb.next();
+
+            void* middle_data = nb.data();
+            NetBufGatherView<4> view(nb);
+
+            REQUIRE(view.size() == 3);
+            REQUIRE(view[1].data() == middle_data);
+            REQUIRE(nb.data() == middle_data);
+            REQUIRE(nb.next());
+            REQUIRE(nb.data() == last_data);
         }
     }
 }
+
+// distinct policy so that this test has a pool all to itself
+typedef mem::experimental::NetBufSlabDefaultPolicy<64, 3> test_slab_policy;
+typedef mem::experimental::NetBufSlabPool<test_slab_policy> test_slab_pool;
+
+TEST_CASE("netbuf slab")
+{
+    typedef mem::experimental::NetBufDynamic<
+        mem::experimental::NetBufSlabAllocator<uint8_t, test_slab_pool>,
+        mem::experimental::NetBufDynamicSlabPolicy<test_slab_pool> > netbuf_type;
+
+    SECTION("size classes")
+    {
+        REQUIRE(test_slab_pool::class_index(1) == 0);
+        REQUIRE(test_slab_pool::class_index(64) == 0);
+        REQUIRE(test_slab_pool::class_index(65) == 1);
+        REQUIRE(test_slab_pool::class_index(256) == 2);
+        // too big for any class
+        REQUIRE(test_slab_pool::class_index(257) == 3);
+    }
+    SECTION("recycle")
+    {
+        void* first_data;
+
+        {
+            netbuf_type nb;
+
+            nb.expand(16, true);
+
+            // minimum allocation fills out smallest class exactly
+            REQUIRE(nb.size() == 64 - (int)sizeof(mem::experimental::NetBufDynamicChunk));
+
+            first_data = nb.data();
+        }
+
+        REQUIRE(test_slab_pool::free_count(0) == 1);
+
+        {
+            netbuf_type nb;
+
+            nb.expand(16, true);
+
+            // steady state: same block comes right back off the free list
+            REQUIRE(nb.data() == first_data);
+            REQUIRE(test_slab_pool::free_count(0) == 0);
+
+            nb.expand(200, true);
+
+            REQUIRE(nb.total_size() == 64 - (int)sizeof(mem::experimental::NetBufDynamicChunk) + 200);
+        }
+
+        REQUIRE(test_slab_pool::free_count(0) == 1);
+        REQUIRE(test_slab_pool::free_count(2) == 1);
+
+        test_slab_pool::release();
+
+        REQUIRE(test_slab_pool::free_count(0) == 0);
+    }
+    SECTION("shrink into smaller class")
+    {
+        {
+            netbuf_type nb;
+
+            nb.expand(200, true);
+            nb.shrink_experimental(16);
+
+            REQUIRE(nb.size() == 16);
+        }
+
+        // 256-byte class block went back on free list during shrink, and 64-byte
+        // class block holding the survivor went back upon destruction
+        REQUIRE(test_slab_pool::free_count(2) == 1);
+        REQUIRE(test_slab_pool::free_count(0) == 1);
+
+        test_slab_pool::release();
+    }
+    SECTION("reserve")
+    {
+        REQUIRE(test_slab_pool::reserve(1, 4));
+        REQUIRE(test_slab_pool::free_count(1) == 4);
+
+        test_slab_pool::release();
+    }
+}
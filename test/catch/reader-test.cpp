@@ -1,6 +1,7 @@
 #include <catch.hpp>
 
 #include <embr/netbuf-static.h>
+#include <embr/netbuf-dynamic.h>
 #include <embr/netbuf-reader.h>
 
 #include <estd/string.h>
@@ -33,4 +34,49 @@ TEST_CASE("reader test", "[reader]")
             REQUIRE(value == data[0]);
         }
     }
+    SECTION("network order integers")
+    {
+        embr::mem::layer2::NetBuf<128> netbuf = { 0x12, 0x34, 0x56, 0x78, 0x9A, 0xBC, 0xDE, 0xF0, 0x01 };
+        embr::mem::NetBufReader<decltype(netbuf)&> reader(netbuf);
+        uint16_t v16;
+        uint32_t v32;
+
+        REQUIRE(reader.read_u16(v16));
+        REQUIRE(v16 == 0x1234);
+        REQUIRE(reader.read_u32(v32));
+        REQUIRE(v32 == 0x56789ABC);
+        REQUIRE(reader.buffer()[0] == 0xDE);
+
+        // only 3 bytes remain
+        REQUIRE(!reader.read_u32(v32));
+    }
+    SECTION("network order integers across chunks")
+    {
+        typedef embr::mem::experimental::NetBufDynamic<> netbuf_type;
+
+        netbuf_type netbuf;
+
+        // 128 byte chunks, value straddles the boundary
+        netbuf.expand(128, false);
+        netbuf.expand(128, false);
+        netbuf.reset();
+
+        uint8_t* first = static_cast<uint8_t*>(netbuf.data());
+        first[126] = 0x12;
+        first[127] = 0x34;
+        netbuf.next();
+        uint8_t* second = static_cast<uint8_t*>(netbuf.data());
+        second[0] = 0x56;
+        second[1] = 0x78;
+        netbuf.reset();
+
+        embr::mem::NetBufReader<netbuf_type&> reader(netbuf);
+        uint32_t v32;
+
+        reader.advance(126);
+
+        REQUIRE(reader.read_u32(v32));
+        REQUIRE(v32 == 0x12345678);
+        REQUIRE(reader.buffer().data() == second + 2);
+    }
 }
@@ -1,6 +1,7 @@
 #include <catch.hpp>
 
 #include <embr/netbuf-static.h>
+#include <embr/netbuf-dynamic.h>
 #include <embr/netbuf-writer.h>
 
 #include <estd/string.h>
@@ -44,8 +45,7 @@ TEST_CASE("writer test", "[writer]")
             REQUIRE(netbuf_data[2] == '2');
             REQUIRE(netbuf_data[3] == 'u');
         }
-        // FIX: These all actually should be failing since we didn't expand
-        // but because bounds checking is currently so weak, it works
+        // writes expand the netbuf as needed
         SECTION("basic << operator")
         {
             uint8_t buffer[] = { 1, 2, 3 };
@@ -70,12 +70,55 @@ TEST_CASE("writer test", "[writer]")
             uint8_t value = 0xFF;
 
             writer << value;
+            writer << (uint8_t)0x7F;
 
             REQUIRE(0xFF == netbuf_data[0]);
+            REQUIRE(0x7F == netbuf_data[1]);
+        }
+        SECTION("write")
+        {
+            const uint8_t hello[] = { 'h', 'e', 'l', 'l', 'o' };
+            estd::const_buffer b(hello, sizeof(hello));
+
+            REQUIRE(writer.write(b) == sizeof(hello));
+            REQUIRE(writer.write(b) == sizeof(hello));
+
+            REQUIRE(memcmp(netbuf_data, "hellohello", 10) == 0);
+
+            // advance stays within what's been allocated
+            size_t remaining = writer.buffer().size();
+
+            REQUIRE(writer.advance(1000) == remaining);
+            REQUIRE(writer.buffer().size() == 0);
+
+            SECTION("partial")
+            {
+                uint8_t big[200] = {};
+
+                // layer2 netbuf caps out at 128
+                REQUIRE(writer.write(big, sizeof(big)) < sizeof(big));
+                REQUIRE(netbuf.size() <= 128);
+            }
         }
         SECTION("chunked write")
         {
 
+        }
+        SECTION("reserve/commit")
+        {
+            // linear netbuf grows in place
+            estd::mutable_buffer b = writer.reserve(4);
+
+            REQUIRE(b.size() >= 4);
+            REQUIRE(b.data() == netbuf_data);
+
+            memcpy(b.data(), "Hi2u", 4);
+            writer.commit(4);
+
+            b = writer.reserve(4);
+
+            REQUIRE(b.data() == netbuf_data + 4);
+            REQUIRE(netbuf_data[3] == 'u');
         }
         SECTION("experimental")
         {
@@ -90,4 +133,104 @@ TEST_CASE("writer test", "[writer]")
             }
         }
     }
+    SECTION("Dynamic netbuf with growth policy")
+    {
+        using namespace embr::mem;
+
+        experimental::NetBufDynamic<> netbuf;
+        NetBufWriter<decltype(netbuf)&,
+            experimental::GeometricGrowthPolicy<128, 4096> > writer(netbuf);
+
+        // serializing a multi-KB payload in small pieces only needs a handful of chunks
+        while(netbuf.total_size() < 3900)
+            REQUIRE(writer.next(16));
+
+        // 128 + 256 + 512 + 1024 + 2048
+        REQUIRE(netbuf.chunk_count() == 5);
+    }
+    SECTION("Dynamic netbuf reserve/commit")
+    {
+        using namespace embr::mem;
+
+        experimental::NetBufDynamic<> netbuf;
+        NetBufWriter<decltype(netbuf)&, experimental::ExactGrowthPolicy> writer(netbuf);
+
+        estd::mutable_buffer b = writer.reserve(100);
+
+        // minimum allocation is 128
+        REQUIRE(b.size() == 128);
+
+        writer.commit(100);
+
+        // would straddle chunks, so caller must fall back to a copy
+        REQUIRE(writer.reserve(64).size() == 0);
+        REQUIRE(writer.reserve(28).size() == 28);
+
+        // more than was reserved is clamped to end of chunk
+        REQUIRE(writer.commit(30) == 28);
+        REQUIRE(writer.buffer().size() == 0);
+
+        // current chunk full, so onto a new one
+        b = writer.reserve(64);
+
+        REQUIRE(b.size() >= 64);
+        REQUIRE(netbuf.chunk_count() == 2);
+    }
+    SECTION("network order integers across chunks")
+    {
+        using namespace embr::mem;
+
+        experimental::NetBufDynamic<> netbuf;
+        NetBufWriter<decltype(netbuf)&, experimental::ExactGrowthPolicy> writer(netbuf);
+
+        writer.reserve(126);
+        writer.commit(126);
+
+        // straddles into a second chunk
+        REQUIRE(writer.write_u32(0x12345678));
+        REQUIRE(netbuf.chunk_count() == 2);
+        REQUIRE(writer.write_u64(0x0102030405060708));
+        REQUIRE(writer.write_u16(0x090A));
+
+        const uint8_t expected[] = { 0x56, 0x78, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10 };
+        const uint8_t* second = static_cast<const uint8_t*>(netbuf.data());
+
+        REQUIRE(memcmp(second, expected, sizeof(expected)) == 0);
+
+        netbuf.reset();
+        const uint8_t* first = static_cast<const uint8_t*>(netbuf.data());
+
+        REQUIRE(first[126] == 0x12);
+        REQUIRE(first[127] == 0x34);
+    }
+    SECTION("batched write")
+    {
+        using namespace embr::mem;
+
+        experimental::NetBufDynamic<> netbuf;
+        NetBufWriter<decltype(netbuf)&, experimental::ExactGrowthPolicy> writer(netbuf);
+        uint8_t header[8], payload[300], trailer[4];
+
+        memset(header, 1, sizeof(header));
+        memset(payload, 2, sizeof(payload));
+        memset(trailer, 3, sizeof(trailer));
+
+        const estd::const_buffer buffers[] =
+        {
+            estd::const_buffer(header, sizeof(header)),
+            estd::const_buffer(payload, sizeof(payload)),
+            estd::const_buffer(trailer, sizeof(trailer))
+        };
+
+        REQUIRE(writer.write(buffers) == 312);
+        // one expansion sized for everything
+        REQUIRE(netbuf.chunk_count() == 1);
+        REQUIRE(netbuf.total_size() == 312);
+
+        const uint8_t* data = static_cast<const uint8_t*>(netbuf.data());
+
+        REQUIRE(data[7] == 1);
+        REQUIRE(data[8] == 2);
+        REQUIRE(data[311] == 3);
+    }
 }